@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Helpers shared by the microbenchmarks.
+ *
+ * The microbenchmarks exercise the data path without a NIC. Notification
+ * buffers and pipes are allocated in regular memory and a synthetic producer,
+ * running on the benchmark thread, plays the role of the NIC by posting
+ * notifications and advancing pipe tails.
+ */
+
+#ifndef ENSO_SOFTWARE_BENCH_BENCH_HELPERS_H_
+#define ENSO_SOFTWARE_BENCH_BENCH_HELPERS_H_
+
+#include <benchmark/benchmark.h>
+#include <enso/consts.h>
+#include <enso/helpers.h>
+#include <enso/internals.h>
+#include <linux/perf_event.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../src/pcie.h"
+
+namespace enso {
+namespace bench {
+
+/**
+ * @brief Counts last-level cache misses for the calling thread using
+ *        `perf_event_open`. If perf events are not available (e.g., inside a
+ *        container), the counter is silently disabled.
+ */
+class CacheMissCounter {
+ public:
+  CacheMissCounter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~CacheMissCounter() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  void Start() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  /**
+   * @brief Temporarily stops counting, e.g., while setting up an iteration.
+   */
+  void Pause() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  /**
+   * @brief Resumes counting after `Pause()`, without resetting the count.
+   */
+  void Resume() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  /**
+   * @brief Stops counting and reports the number of cache misses per iteration
+   *        in the `cache_misses` counter of `state`.
+   */
+  void Stop(benchmark::State& state) {
+    if (fd_ < 0) {
+      return;
+    }
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+      return;
+    }
+    state.counters["cache_misses"] = benchmark::Counter(
+        count, benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  int fd_;
+};
+
+/**
+ * @brief Allocates `size` bytes that are mapped twice in sequence, like the
+ *        buffers used by Enso pipes. Uses huge pages when available.
+ *
+ * @return Address of the buffer, or nullptr on failure.
+ */
+inline void* alloc_mirrored_buf(size_t size) {
+  int fd = memfd_create("enso_bench", MFD_HUGETLB);
+  if (fd < 0 || ftruncate(fd, size) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    fd = memfd_create("enso_bench", 0);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+      return nullptr;
+    }
+  }
+
+  void* addr = mmap(nullptr, size * 2, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  void* first = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                     fd, 0);
+  void* second = mmap((uint8_t*)addr + size, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED, fd, 0);
+  close(fd);
+
+  if (addr == MAP_FAILED || first == MAP_FAILED || second == MAP_FAILED) {
+    return nullptr;
+  }
+  memset(addr, 0, size);
+  return addr;
+}
+
+inline void free_mirrored_buf(void* addr, size_t size) {
+  munmap(addr, size * 2);
+}
+
+/**
+ * @brief Writes a minimal IPv4 packet of `pkt_size` bytes to `dst`.
+ *
+ * @return Number of bytes (multiple of 64) used by the packet in the pipe.
+ */
+inline uint32_t write_pkt(uint8_t* dst, uint16_t pkt_size) {
+  struct ether_header* l2_hdr = (struct ether_header*)dst;
+  struct iphdr* l3_hdr = (struct iphdr*)(l2_hdr + 1);
+  l2_hdr->ether_type = htons(ETHERTYPE_IP);
+  l3_hdr->version = 4;
+  l3_hdr->ihl = 5;
+  l3_hdr->tot_len = htons(pkt_size - sizeof(*l2_hdr));
+  return ((pkt_size - 1) / 64 + 1) * 64;
+}
+
+/**
+ * @brief Notification buffer pair and RX pipes backed by regular memory, with
+ *        a synthetic producer standing in for the NIC.
+ */
+class SyntheticDataPath {
+ public:
+  /**
+   * @param nb_pipes Number of RX pipes associated with the notification buffer.
+   * @param alloc_bufs Whether to allocate memory for the pipes' data. Only
+   *                   needed by benchmarks that touch the packets.
+   */
+  explicit SyntheticDataPath(uint32_t nb_pipes, bool alloc_bufs = false)
+      : pipes_(nb_pipes) {
+    regs_ = (struct QueueRegs*)mmap(
+        nullptr, (size_t)kMemorySpacePerQueue * (kMaxNbFlows + 1),
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1, 0);
+
+    struct NotificationBufPair* nbp = &notification_buf_pair_;
+    nbp->rx_buf = (struct RxNotification*)aligned_alloc(
+        kBufPageSize, kAlignedDscBufPairSize);
+    memset(nbp->rx_buf, 0, kAlignedDscBufPairSize);
+    nbp->tx_buf = (struct TxNotification*)((uint8_t*)nbp->rx_buf +
+                                           kAlignedDscBufPairSize / 2);
+    nbp->next_rx_pipe_notifs = (struct RxNotification**)malloc(
+        kNextRxNotifsSize * sizeof(struct RxNotification*));
+    nbp->wrap_tracker = (uint8_t*)calloc(kNotificationBufSize / 8, 1);
+    rx_pipe_slots_init(nbp);
+    nbp->notif_gen = 0;
+    nbp->coalesce_notifs = false;
+    nbp->uio_mmap_bar2_addr = regs_;
+    nbp->regs = reg_addr(kMaxNbFlows);
+    nbp->rx_head_ptr = &nbp->regs->rx_head;
+    nbp->tx_tail_ptr = &nbp->regs->tx_tail;
+    nbp->rx_head = 0;
+    nbp->tx_head = 0;
+    nbp->tx_tail = 0;
+    nbp->tx_tail_reported = 0;
+    nbp->tx_tail_flush_threshold = 0;
+    nbp->next_rx_ids_head = 0;
+    nbp->next_rx_ids_tail = 0;
+    nbp->nb_unreported_completions = 0;
+    nbp->id = 0;
+    nbp->tx_full_cnt = 0;
+    nbp->ref_cnt = 0;
+    nbp->fpga_dev = nullptr;
+
+    for (uint32_t i = 0; i < nb_pipes; ++i) {
+      struct RxEnsoPipeInternal* pipe = &pipes_[i];
+      pipe->buf = alloc_bufs ? (uint32_t*)alloc_mirrored_buf(kBufPageSize)
+                             : nullptr;
+      pipe->id = i;
+      pipe->slot = assign_rx_pipe_slot(nbp, i);
+      pipe->regs = reg_addr(i);
+      pipe->buf_head_ptr = &pipe->regs->rx_head;
+      pipe->buf_phys_addr = (uint64_t)pipe->buf;
+      pipe->phys_buf_offset = 0;
+      pipe->rx_head = 0;
+      pipe->rx_tail = 0;
+      pipe->last_reported_head = 0;
+      pipe->head_update_threshold = 0;
+      pipe->mask = kEnsoPipeSize - 1;
+      pipe->uio_mmap_bar2_addr = regs_;
+    }
+  }
+
+  ~SyntheticDataPath() {
+    for (auto& pipe : pipes_) {
+      if (pipe.buf != nullptr) {
+        free_mirrored_buf(pipe.buf, kBufPageSize);
+      }
+    }
+    struct NotificationBufPair* nbp = &notification_buf_pair_;
+    free(nbp->rx_buf);
+    free(nbp->next_rx_pipe_notifs);
+    rx_pipe_slots_free(nbp);
+    free(nbp->wrap_tracker);
+    munmap(regs_, (size_t)kMemorySpacePerQueue * (kMaxNbFlows + 1));
+  }
+
+  SyntheticDataPath(const SyntheticDataPath&) = delete;
+  SyntheticDataPath& operator=(const SyntheticDataPath&) = delete;
+
+  struct NotificationBufPair* notification_buf_pair() {
+    return &notification_buf_pair_;
+  }
+
+  struct RxEnsoPipeInternal* pipe(uint32_t i) { return &pipes_[i]; }
+
+  uint32_t nb_pipes() const { return pipes_.size(); }
+
+  /**
+   * @brief Fills every pipe with back-to-back packets of `pkt_size` bytes. Pipes
+   *        must have been created with `alloc_bufs` set.
+   *
+   * @return Number of whole packets that fit in a pipe.
+   */
+  uint32_t FillPipes(uint16_t pkt_size) {
+    uint32_t pkt_bytes = ((pkt_size - 1) / 64 + 1) * 64;
+    uint32_t nb_pkts = (kEnsoPipeSize * 64) / pkt_bytes;
+    for (auto& pipe : pipes_) {
+      uint8_t* buf = (uint8_t*)pipe.buf;
+      for (uint32_t i = 0; i < nb_pkts; ++i) {
+        write_pkt(buf + i * pkt_bytes, pkt_size);
+      }
+    }
+    return nb_pkts;
+  }
+
+  /**
+   * @brief Evicts the state of the notification buffer and of the pipes from
+   *        the cache, so that the next access to each of its cache lines
+   *        misses.
+   */
+  void EvictState() {
+    struct NotificationBufPair* nbp = &notification_buf_pair_;
+    evict(nbp, sizeof(*nbp));
+    evict(nbp->next_rx_pipe_notifs,
+          kNextRxNotifsSize * sizeof(*nbp->next_rx_pipe_notifs));
+    evict(nbp->rx_pipe_slot_map,
+          (nbp->rx_pipe_slot_map_mask + 1) * sizeof(*nbp->rx_pipe_slot_map));
+    evict(nbp->rx_pipe_slots,
+          nbp->nb_rx_pipe_slots * sizeof(*nbp->rx_pipe_slots));
+    evict(pipes_.data(), pipes_.size() * sizeof(pipes_[0]));
+    _mm_mfence();
+  }
+
+  /**
+   * @brief Acts as the NIC, posting `nb_notifications` RX notifications. Each
+   *        notification goes to the next pipe (round robin) and advances its
+   *        tail by `nb_flits`.
+   */
+  _enso_always_inline void ProduceRxNotifications(uint32_t nb_notifications,
+                                                  uint32_t nb_flits) {
+    struct RxNotification* rx_buf = notification_buf_pair_.rx_buf;
+    for (uint32_t i = 0; i < nb_notifications; ++i) {
+      struct RxNotification* notification = rx_buf + producer_notif_tail_;
+      uint32_t pipe_id = next_pipe_;
+      next_pipe_ = (next_pipe_ + 1 == pipes_.size()) ? 0 : next_pipe_ + 1;
+      producer_pipe_tails_[pipe_id] =
+          (producer_pipe_tails_[pipe_id] + nb_flits) % kEnsoPipeSize;
+      notification->queue_id = pipe_id;
+      notification->tail = producer_pipe_tails_[pipe_id];
+      notification->signal = 1;
+      producer_notif_tail_ = (producer_notif_tail_ + 1) % kNotificationBufSize;
+    }
+  }
+
+  /**
+   * @brief Acts as the NIC, consuming up to `nb_notifications` TX
+   *        notifications.
+   */
+  _enso_always_inline void ConsumeTxNotifications(uint32_t nb_notifications) {
+    struct TxNotification* tx_buf = notification_buf_pair_.tx_buf;
+    for (uint32_t i = 0; i < nb_notifications; ++i) {
+      if (producer_tx_head_ == notification_buf_pair_.tx_tail) {
+        break;
+      }
+      tx_buf[producer_tx_head_].signal = 0;
+      producer_tx_head_ = (producer_tx_head_ + 1) % kNotificationBufSize;
+    }
+  }
+
+ private:
+  static void evict(const void* addr, size_t size) {
+    uint64_t line = (uint64_t)addr & ~((uint64_t)kCacheLineSize - 1);
+    for (; line < (uint64_t)addr + size; line += kCacheLineSize) {
+      _mm_clflush((const void*)line);
+    }
+  }
+
+  struct QueueRegs* reg_addr(uint32_t queue_id) {
+    return (struct QueueRegs*)((uint8_t*)regs_ +
+                               (uint64_t)queue_id * kMemorySpacePerQueue);
+  }
+
+  struct QueueRegs* regs_;
+  struct NotificationBufPair notification_buf_pair_;
+  std::vector<struct RxEnsoPipeInternal> pipes_;
+  std::vector<uint32_t> producer_pipe_tails_ =
+      std::vector<uint32_t>(kMaxNbFlows, 0);
+  uint32_t producer_notif_tail_ = 0;
+  uint32_t producer_tx_head_ = 0;
+  uint32_t next_pipe_ = 0;
+};
+
+}  // namespace bench
+}  // namespace enso
+
+#endif  // ENSO_SOFTWARE_BENCH_BENCH_HELPERS_H_
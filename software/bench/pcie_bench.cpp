@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Microbenchmarks for the functions in the data path (`pcie.cpp`).
+ *
+ * Every benchmark reports the time per operation, the number of items
+ * (notifications, packets, or requests) per second and, when available, the
+ * number of cache misses per iteration.
+ *
+ * Benchmarks that need notifications include the cost of the synthetic
+ * producer, which is measured on its own by `BM_ProduceRxNotifications`.
+ */
+
+#include <benchmark/benchmark.h>
+#include <enso/consts.h>
+#include <enso/fast_path.h>
+#include <enso/internals.h>
+#include <enso/pipe.h>
+#include <x86intrin.h>
+
+#include <algorithm>
+
+#include "../src/pcie.h"
+#include "bench_helpers.h"
+
+namespace enso {
+namespace bench {
+
+static void set_items(benchmark::State& state, uint64_t items_per_iteration) {
+  state.SetItemsProcessed(state.iterations() * items_per_iteration);
+}
+
+// Args: {notifications per poll, number of pipes}.
+static void RxNotificationArgs(benchmark::internal::Benchmark* b) {
+  for (int64_t nb_pipes : {1, 16, 256, 4096}) {
+    for (int64_t batch_size : {1, 8, 32, 64}) {
+      b->Args({batch_size, nb_pipes});
+    }
+  }
+  b->ArgNames({"batch", "pipes"});
+}
+
+static void BM_ProduceRxNotifications(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+  SyntheticDataPath data_path(state.range(1));
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    data_path.ProduceRxNotifications(batch_size, 1);
+    benchmark::ClobberMemory();
+  }
+  cache_misses.Stop(state);
+  set_items(state, batch_size);
+}
+BENCHMARK(BM_ProduceRxNotifications)->Apply(RxNotificationArgs);
+
+static void BM_GetNewTails(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+  SyntheticDataPath data_path(state.range(1));
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    data_path.ProduceRxNotifications(batch_size, 1);
+    benchmark::DoNotOptimize(get_new_tails(nbp));
+
+    // Drop the notifications, we only care about the cost of fetching them.
+    nbp->next_rx_ids_head = nbp->next_rx_ids_tail;
+  }
+  cache_misses.Stop(state);
+  set_items(state, batch_size);
+}
+BENCHMARK(BM_GetNewTails)->Apply(RxNotificationArgs);
+
+// Args: {notifications per poll}. Calls a hook for every notification, like
+// `Device::RecvBurst()` does for RX/TX pipes. With `kStatic`, the hook is a
+// lambda resolved at compile time. Otherwise, it is an `UpdatePacket`
+// (`std::function`).
+template <bool kStatic>
+static void BM_GetNewTailsWithHook(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+  SyntheticDataPath data_path(16);
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  uint64_t sum = 0;
+  auto hook = [&sum](enso_pipe_id_t enso_pipe_id, uint64_t sent_time,
+                     uint32_t prev_tail) {
+    sum += enso_pipe_id + sent_time + prev_tail;
+  };
+  UpdatePacket dynamic_hook = hook;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    data_path.ProduceRxNotifications(batch_size, 1);
+    if constexpr (kStatic) {
+      benchmark::DoNotOptimize(
+          fast_path::get_new_tails<fast_path::DirectMmio>(nbp, hook));
+    } else {
+      benchmark::DoNotOptimize(
+          fast_path::get_new_tails<fast_path::DirectMmio>(nbp, dynamic_hook));
+    }
+    nbp->next_rx_ids_head = nbp->next_rx_ids_tail;
+  }
+  cache_misses.Stop(state);
+  benchmark::DoNotOptimize(sum);
+  set_items(state, batch_size);
+}
+BENCHMARK_TEMPLATE(BM_GetNewTailsWithHook, true)
+    ->Arg(8)
+    ->Arg(64)
+    ->ArgName("batch");
+BENCHMARK_TEMPLATE(BM_GetNewTailsWithHook, false)
+    ->Arg(8)
+    ->Arg(64)
+    ->ArgName("batch");
+
+static void BM_GetNextRxNotif(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+  SyntheticDataPath data_path(state.range(1));
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    data_path.ProduceRxNotifications(batch_size, 1);
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      benchmark::DoNotOptimize(get_next_rx_notif(nbp));
+    }
+  }
+  cache_misses.Stop(state);
+  set_items(state, batch_size);
+}
+BENCHMARK(BM_GetNextRxNotif)->Apply(RxNotificationArgs);
+
+// Args: {notifications per batch, number of pipes, coalesce}. Visits every pipe
+// returned by `get_next_rx_notif` and consumes its data, like
+// `Device::NextRxPipeToRecv` followed by `RxPipe::RecvBytes`.
+static void BM_VisitRxPipes(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+  SyntheticDataPath data_path(state.range(1));
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  set_notif_coalescing(nbp, state.range(2));
+  uint64_t nb_visits = 0;
+  uint64_t nb_bytes = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    data_path.ProduceRxNotifications(batch_size, 1);
+    struct RxNotification* notification;
+    while ((notification = get_next_rx_notif(nbp)) != nullptr) {
+      void* buf;
+      nb_bytes += get_next_batch_from_queue(
+          data_path.pipe(notification->queue_id), nbp, &buf);
+      ++nb_visits;
+      if (nbp->next_rx_ids_head == nbp->next_rx_ids_tail) {
+        break;
+      }
+    }
+  }
+  cache_misses.Stop(state);
+  set_items(state, batch_size);
+  state.counters["bytes_per_visit"] = (double)nb_bytes / nb_visits;
+}
+BENCHMARK(BM_VisitRxPipes)
+    ->ArgsProduct({{8, 64}, {1, 16, 256}, {0, 1}})
+    ->ArgNames({"batch", "pipes", "coalesce"});
+
+// Args: {number of pipes}. Every pipe gets one notification and consumes its
+// data. The state of the notification buffer and of the pipes is evicted from
+// the cache before each batch, so `cache_misses` approximates the number of
+// cache lines that a batch touches.
+static void BM_VisitColdRxPipes(benchmark::State& state) {
+  uint32_t nb_pipes = state.range(0);
+  SyntheticDataPath data_path(nb_pipes);
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    state.PauseTiming();
+    cache_misses.Pause();
+    data_path.ProduceRxNotifications(nb_pipes, 1);
+    data_path.EvictState();
+    cache_misses.Resume();
+    state.ResumeTiming();
+
+    struct RxNotification* notification;
+    while ((notification = get_next_rx_notif(nbp)) != nullptr) {
+      struct RxEnsoPipeInternal* pipe = data_path.pipe(notification->queue_id);
+      void* buf;
+      uint32_t nb_bytes = get_next_batch_from_queue(pipe, nbp, &buf);
+      advance_pipe(pipe, nb_bytes);
+      if (nbp->next_rx_ids_head == nbp->next_rx_ids_tail) {
+        break;
+      }
+    }
+  }
+  cache_misses.Stop(state);
+  set_items(state, nb_pipes);
+}
+BENCHMARK(BM_VisitColdRxPipes)->Arg(1)->Arg(16)->Arg(64)->ArgName("pipes");
+
+// Args: {flits per notification, number of pipes}.
+static void BM_PeekNextBatchFromQueue(benchmark::State& state) {
+  uint32_t nb_flits = state.range(0);
+  SyntheticDataPath data_path(state.range(1));
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  uint32_t nb_pipes = data_path.nb_pipes();
+  uint32_t pipe_id = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    struct RxEnsoPipeInternal* pipe = data_path.pipe(pipe_id);
+    pipe_id = (pipe_id + 1 == nb_pipes) ? 0 : pipe_id + 1;
+
+    // What `get_new_tails` does when a notification arrives.
+    struct RxPipeSlot* rx_pipe_slot = &nbp->rx_pipe_slots[pipe->slot];
+    rx_pipe_slot->pending_tail =
+        (rx_pipe_slot->pending_tail + nb_flits) % kEnsoPipeSize;
+
+    void* buf;
+    uint32_t nb_bytes = peek_next_batch_from_queue(pipe, nbp, &buf);
+    benchmark::DoNotOptimize(buf);
+
+    // Confirm the bytes, like `RxPipe::ConfirmBytes`.
+    pipe->rx_tail = (pipe->rx_tail + nb_bytes / 64) % kEnsoPipeSize;
+  }
+  cache_misses.Stop(state);
+  set_items(state, 1);
+  state.SetBytesProcessed(state.iterations() * nb_flits * 64);
+}
+BENCHMARK(BM_PeekNextBatchFromQueue)
+    ->ArgsProduct({{1, 16, 64, 1024}, {1, 16, 256, 4096}})
+    ->ArgNames({"flits", "pipes"});
+
+// Args: {bytes per request, TX flush threshold}.
+static void BM_SendToQueue(benchmark::State& state) {
+  uint32_t len = state.range(0);
+  SyntheticDataPath data_path(1, true);
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  set_tx_flush_threshold(nbp, state.range(1));
+  uint64_t buf_addr = (uint64_t)data_path.pipe(0)->buf;
+  uint64_t offset = 0;
+  uint32_t pending_requests = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(send_to_queue(nbp, buf_addr + offset, len));
+    offset = (offset + len) % kBufPageSize;
+
+    // Periodically act as the NIC and reclaim the notifications so that
+    // `send_to_queue` never blocks.
+    if (unlikely(++pending_requests == kBatchSize)) {
+      state.PauseTiming();
+      data_path.ConsumeTxNotifications(kNotificationBufSize);
+      update_tx_head(nbp);
+      nbp->nb_unreported_completions = 0;
+      pending_requests = 0;
+      state.ResumeTiming();
+    }
+  }
+  cache_misses.Stop(state);
+  set_items(state, 1);
+  state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_SendToQueue)
+    ->ArgsProduct({{64, 1536, 16384, kMaxTransferLen, kBufPageSize}, {0, 16}})
+    ->ArgNames({"len", "threshold"});
+
+// Args: {completed notifications per call}.
+static void BM_UpdateTxHead(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+  SyntheticDataPath data_path(1);
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    // All notifications have their signal cleared, so advancing the tail is
+    // equivalent to sending `batch_size` requests that were already completed
+    // by the NIC.
+    nbp->tx_tail = (nbp->tx_tail + batch_size) % kNotificationBufSize;
+    update_tx_head(nbp);
+    benchmark::DoNotOptimize(nbp->nb_unreported_completions);
+  }
+  cache_misses.Stop(state);
+  set_items(state, batch_size);
+}
+BENCHMARK(BM_UpdateTxHead)->Arg(1)->Arg(8)->Arg(32)->Arg(64)->ArgName("batch");
+
+// Args: {bytes freed per call, head update threshold in bytes}. Receives and
+// frees data from a pipe like `RxPipe::Recv` followed by `RxPipe::Free`.
+static void BM_AdvancePipe(benchmark::State& state) {
+  uint32_t nb_bytes = state.range(0);
+  SyntheticDataPath data_path(1);
+  struct RxEnsoPipeInternal* pipe = data_path.pipe(0);
+  set_pipe_head_update_threshold(pipe, state.range(1) / 64);
+  uint64_t nb_reports = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    uint32_t last_reported_head = pipe->last_reported_head;
+    pipe->rx_tail = (pipe->rx_tail + nb_bytes / 64) % kEnsoPipeSize;
+    advance_pipe(pipe, nb_bytes);
+    nb_reports += pipe->last_reported_head != last_reported_head;
+  }
+  cache_misses.Stop(state);
+  set_items(state, 1);
+  state.counters["reports_per_call"] =
+      (double)nb_reports / std::max<uint64_t>(state.iterations(), 1);
+}
+BENCHMARK(BM_AdvancePipe)
+    ->ArgsProduct({{64, 1024}, {0, 4096, 65536}})
+    ->ArgNames({"bytes", "threshold"});
+
+// Args: {packet size, packets per batch}.
+static void BM_PeekPktIterator(benchmark::State& state) {
+  uint16_t pkt_size = state.range(0);
+  uint32_t batch_size = state.range(1);
+  SyntheticDataPath data_path(1, true);
+  uint32_t nb_pkts = data_path.FillPipes(pkt_size);
+  uint32_t pkt_bytes = ((pkt_size - 1) / 64 + 1) * 64;
+  uint32_t batch_bytes = batch_size * pkt_bytes;
+  uint32_t ring_bytes = nb_pkts * pkt_bytes;
+  uint8_t* buf = (uint8_t*)data_path.pipe(0)->buf;
+  uint32_t offset = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    RxPipe::MessageBatch<PeekPktIterator> batch;
+    PeekPktIterator it(buf + offset, -1, &batch);
+    PeekPktIterator end(buf + offset + batch_bytes, -1, &batch);
+    for (; it != end; ++it) {
+      uint8_t* pkt = *it;
+      benchmark::DoNotOptimize(pkt);
+    }
+    offset += batch_bytes;
+    if (offset + batch_bytes > ring_bytes) {
+      offset = 0;
+    }
+  }
+  cache_misses.Stop(state);
+  set_items(state, batch_size);
+  state.SetBytesProcessed(state.iterations() * batch_bytes);
+}
+BENCHMARK(BM_PeekPktIterator)
+    ->ArgsProduct({{64, 256, 1500}, {1, 16, 64, 256}})
+    ->ArgNames({"pkt_size", "batch"});
+
+// Args: {flits per batch}. Receives a batch, frees it and sends it back, like
+// the loop in the `echo` example. With `kInline`, it uses the functions in
+// `enso/fast_path.h`, which the pipe methods inline into the application.
+// Otherwise, it calls the library through function pointers, which is what
+// an application built without LTO gets. Reports the cycles per batch.
+template <bool kInline>
+static void BM_EchoLoop(benchmark::State& state) {
+  uint32_t nb_flits = state.range(0);
+  SyntheticDataPath data_path(1, true);
+  struct NotificationBufPair* nbp = data_path.notification_buf_pair();
+  struct RxEnsoPipeInternal* pipe = data_path.pipe(0);
+
+  uint16_t (*get_new_tails_fn)(struct NotificationBufPair*, UpdatePacket) =
+      get_new_tails;
+  uint32_t (*get_next_batch_fn)(struct RxEnsoPipeInternal*,
+                                struct NotificationBufPair*, void**) =
+      get_next_batch_from_queue;
+  void (*advance_pipe_fn)(struct RxEnsoPipeInternal*, size_t) = advance_pipe;
+  uint32_t (*send_to_queue_fn)(struct NotificationBufPair*, uint64_t,
+                               uint32_t, uint64_t) = send_to_queue;
+  benchmark::DoNotOptimize(get_new_tails_fn);
+  benchmark::DoNotOptimize(get_next_batch_fn);
+  benchmark::DoNotOptimize(advance_pipe_fn);
+  benchmark::DoNotOptimize(send_to_queue_fn);
+
+  uint32_t nb_batches = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  uint64_t start_cycles = __rdtsc();
+  for (auto _ : state) {
+    data_path.ProduceRxNotifications(1, nb_flits);
+
+    void* buf;
+    uint32_t nb_bytes;
+    if constexpr (kInline) {
+      fast_path::get_new_tails<fast_path::DirectMmio>(nbp);
+      nb_bytes = fast_path::consume_queue(pipe, nbp, &buf);
+      fast_path::advance_pipe<fast_path::DirectMmio>(pipe, nb_bytes);
+      fast_path::send_to_queue<fast_path::DirectMmio>(nbp, (uint64_t)buf,
+                                                      nb_bytes);
+    } else {
+      get_new_tails_fn(nbp, NULL);
+      nb_bytes = get_next_batch_fn(pipe, nbp, &buf);
+      advance_pipe_fn(pipe, nb_bytes);
+      send_to_queue_fn(nbp, (uint64_t)buf, nb_bytes, 0);
+    }
+
+    // Act as the NIC and reclaim the notifications, so that sending never
+    // blocks.
+    data_path.ConsumeTxNotifications(1);
+    if (unlikely(++nb_batches == kBatchSize)) {
+      update_tx_head(nbp);
+      nbp->nb_unreported_completions = 0;
+      nb_batches = 0;
+    }
+  }
+  uint64_t cycles = __rdtsc() - start_cycles;
+  cache_misses.Stop(state);
+  set_items(state, 1);
+  state.SetBytesProcessed(state.iterations() * nb_flits * 64);
+  state.counters["cycles_per_batch"] =
+      (double)cycles / std::max<uint64_t>(state.iterations(), 1);
+}
+BENCHMARK_TEMPLATE(BM_EchoLoop, true)->Arg(1)->Arg(16)->ArgName("flits");
+BENCHMARK_TEMPLATE(BM_EchoLoop, false)->Arg(1)->Arg(16)->ArgName("flits");
+
+}  // namespace bench
+}  // namespace enso
+
+BENCHMARK_MAIN();
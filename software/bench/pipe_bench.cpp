@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Benchmarks for the pipe API (`pipe.h`) using an actual `Device`.
+ *
+ * These benchmarks need a device. When Enso is built with the software
+ * backend (`-Ddev_backend=software`), the emulated NIC acts as the producer,
+ * allowing them to run without hardware. Otherwise, traffic must be sent to
+ * the NIC while the benchmark is running. Benchmarks are skipped if the device
+ * cannot be created.
+ */
+
+#include <arpa/inet.h>
+#include <benchmark/benchmark.h>
+#include <enso/helpers.h>
+#include <enso/pipe.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "bench_helpers.h"
+
+namespace enso {
+namespace bench {
+
+static const uint32_t kBaseIpAddress = ntohl(inet_addr("192.168.0.0"));
+static constexpr uint32_t kDstPort = 80;
+static constexpr uint32_t kProtocol = 0x11;
+
+/**
+ * @brief Creates a device with `nb_pipes` RX pipes, each bound to a different
+ *        flow.
+ */
+static std::unique_ptr<Device> create_device(uint32_t nb_pipes,
+                                             uint16_t pkt_size) {
+  // Only used by the software backend.
+  setenv("ENSO_SW_NIC_PKT_SIZE", std::to_string(pkt_size).c_str(), 1);
+
+  std::unique_ptr<Device> dev = Device::Create();
+  if (!dev) {
+    return nullptr;
+  }
+
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    RxPipe* pipe = dev->AllocateRxPipe();
+    if (pipe == nullptr) {
+      return nullptr;
+    }
+    pipe->Bind(kDstPort, 0, kBaseIpAddress + i, 0, kProtocol);
+  }
+
+  return dev;
+}
+
+// Args: {packet size, number of pipes}.
+template <typename Iterator>
+static void BM_DeviceRecv(benchmark::State& state) {
+  std::unique_ptr<Device> dev = create_device(state.range(1), state.range(0));
+  if (!dev) {
+    state.SkipWithError("Could not create device");
+    return;
+  }
+
+  uint64_t nb_pkts = 0;
+  uint64_t nb_bytes = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    RxPipe* pipe = dev->NextRxPipeToRecv();
+    if (pipe == nullptr) {
+      continue;
+    }
+    auto batch = pipe->RecvMessages<Iterator>();
+    for (auto pkt : batch) {
+      benchmark::DoNotOptimize(pkt);
+      ++nb_pkts;
+    }
+    nb_bytes += batch.processed_bytes();
+    if constexpr (std::is_same_v<Iterator, PeekPktIterator>) {
+      pipe->ConfirmBytes(batch.processed_bytes());
+    }
+    pipe->Clear();
+  }
+  cache_misses.Stop(state);
+
+  state.SetItemsProcessed(nb_pkts);
+  state.SetBytesProcessed(nb_bytes);
+}
+BENCHMARK_TEMPLATE(BM_DeviceRecv, PktIterator)
+    ->ArgsProduct({{64, 256, 1500}, {1, 4, 16}})
+    ->ArgNames({"pkt_size", "pipes"});
+BENCHMARK_TEMPLATE(BM_DeviceRecv, PeekPktIterator)
+    ->ArgsProduct({{64, 256, 1500}, {1, 4, 16}})
+    ->ArgNames({"pkt_size", "pipes"});
+
+static constexpr uint32_t kSmallPipeSize = 4096;  // bytes.
+
+/**
+ * @brief Creates a device with `nb_pipes` small RX pipes, of which only the
+ *        first `nb_active_pipes` are bound to a flow and receive packets.
+ */
+static std::unique_ptr<Device> create_idle_device(uint32_t nb_pipes,
+                                                  uint32_t nb_active_pipes,
+                                                  std::vector<RxPipe*>* pipes) {
+  setenv("ENSO_SW_NIC_PKT_SIZE", "64", 1);
+
+  std::unique_ptr<Device> dev = Device::Create();
+  if (!dev) {
+    return nullptr;
+  }
+
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    RxPipe* pipe = dev->AllocateRxPipe(false, kSmallPipeSize);
+    if (pipe == nullptr) {
+      return nullptr;
+    }
+    if (i < nb_active_pipes) {
+      pipe->Bind(kDstPort, 0, kBaseIpAddress + i, 0, kProtocol);
+    }
+    pipes->push_back(pipe);
+  }
+
+  return dev;
+}
+
+// Args: {number of pipes, number of pipes receiving packets}.
+static void BM_PollPipeGroup(benchmark::State& state) {
+  std::vector<RxPipe*> pipes;
+  std::unique_ptr<Device> dev =
+      create_idle_device(state.range(0), state.range(1), &pipes);
+  if (!dev) {
+    state.SkipWithError("Could not create device");
+    return;
+  }
+
+  PipeGroup* group = dev->AllocatePipeGroup();
+  for (RxPipe* pipe : pipes) {
+    group->Add(pipe);
+  }
+
+  uint32_t indices[kBatchSize];
+  uint64_t nb_pkts = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    uint32_t nb_pipes = group->PollAll(indices, kBatchSize);
+    for (uint32_t i = 0; i < nb_pipes; ++i) {
+      RxPipe* pipe = group->rx_pipe(indices[i]);
+      auto batch = pipe->RecvPkts();
+      for (auto pkt : batch) {
+        benchmark::DoNotOptimize(pkt);
+        ++nb_pkts;
+      }
+      pipe->Clear();
+    }
+  }
+  cache_misses.Stop(state);
+
+  state.SetItemsProcessed(nb_pkts);
+}
+BENCHMARK(BM_PollPipeGroup)
+    ->ArgsProduct({{64, 512}, {1, 8}})
+    ->ArgNames({"pipes", "active"});
+
+// Same as `BM_PollPipeGroup` but checking every pipe individually.
+static void BM_PollEveryPipe(benchmark::State& state) {
+  std::vector<RxPipe*> pipes;
+  std::unique_ptr<Device> dev =
+      create_idle_device(state.range(0), state.range(1), &pipes);
+  if (!dev) {
+    state.SkipWithError("Could not create device");
+    return;
+  }
+
+  uint64_t nb_pkts = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    for (RxPipe* pipe : pipes) {
+      auto batch = pipe->RecvPkts();
+      for (auto pkt : batch) {
+        benchmark::DoNotOptimize(pkt);
+        ++nb_pkts;
+      }
+      pipe->Clear();
+    }
+  }
+  cache_misses.Stop(state);
+
+  state.SetItemsProcessed(nb_pkts);
+}
+BENCHMARK(BM_PollEveryPipe)
+    ->ArgsProduct({{64, 512}, {1, 8}})
+    ->ArgNames({"pipes", "active"});
+
+// Args: {number of pipes, completions reap interval}.
+static void BM_RxTxEcho(benchmark::State& state) {
+  setenv("ENSO_SW_NIC_PKT_SIZE", "64", 1);
+
+  std::unique_ptr<Device> dev = Device::Create();
+  if (!dev) {
+    state.SkipWithError("Could not create device");
+    return;
+  }
+
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    RxTxPipe* pipe = dev->AllocateRxTxPipe(false, kSmallPipeSize);
+    if (pipe == nullptr) {
+      state.SkipWithError("Could not allocate pipe");
+      return;
+    }
+    pipe->Bind(kDstPort, 0, kBaseIpAddress + i, 0, kProtocol);
+  }
+
+  if (dev->SetCompletionsReapInterval(state.range(1))) {
+    state.SkipWithError("Could not set reap interval");
+    return;
+  }
+
+  uint64_t nb_pkts = 0;
+  CacheMissCounter cache_misses;
+
+  cache_misses.Start();
+  for (auto _ : state) {
+    RxTxPipe* pipe = dev->NextRxTxPipeToRecv();
+    if (pipe == nullptr) {
+      continue;
+    }
+    auto batch = pipe->RecvPkts();
+    for (auto pkt : batch) {
+      benchmark::DoNotOptimize(pkt);
+      ++nb_pkts;
+    }
+    pipe->SendAndFree(batch.processed_bytes());
+  }
+  cache_misses.Stop(state);
+
+  state.SetItemsProcessed(nb_pkts);
+}
+BENCHMARK(BM_RxTxEcho)
+    ->ArgsProduct({{4, 256}, {1, 8}})
+    ->ArgNames({"pipes", "reap_interval"});
+
+// Args: {number of pipes, whether to fill the pipe pool first}.
+static void BM_AllocateRxPipes(benchmark::State& state) {
+  uint32_t nb_pipes = state.range(0);
+  bool use_pool = state.range(1);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::unique_ptr<Device> dev = Device::Create();
+    if (!dev) {
+      state.SkipWithError("Could not create device");
+      return;
+    }
+    state.ResumeTiming();
+
+    if (use_pool && dev->FillPipePool(nb_pipes)) {
+      state.SkipWithError("Could not fill pipe pool");
+      return;
+    }
+    for (uint32_t i = 0; i < nb_pipes; ++i) {
+      benchmark::DoNotOptimize(dev->AllocateRxPipe());
+    }
+
+    state.PauseTiming();
+    dev.reset();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * nb_pipes);
+}
+BENCHMARK(BM_AllocateRxPipes)
+    ->ArgsProduct({{8, 16}, {0, 1}})
+    ->ArgNames({"pipes", "pool"})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace bench
+}  // namespace enso
+
+BENCHMARK_MAIN();
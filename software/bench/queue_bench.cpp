@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Benchmarks for the inter-thread queues (`queue.h`).
+ *
+ * Producer and consumer run on the benchmark thread, pushing a batch and then
+ * popping it back. This isolates the per-element cost of the queue from the
+ * cost of moving the elements between cores.
+ */
+
+#include <benchmark/benchmark.h>
+#include <enso/queue.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace enso {
+namespace bench {
+
+struct Descriptor {
+  uint64_t addr;
+  uint32_t length;
+  uint32_t pipe_id;
+};
+
+static constexpr uint32_t kMaxQueueBatch = 64;
+
+// Args: {elements per batch, whether to use PushBatch/PopBatch}.
+static void BM_QueuePushPop(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+  bool use_batch = state.range(1);
+
+  // Every run leaves the queue empty, so the same queue is reused instead of
+  // allocating a huge page for every run.
+  static auto producer = QueueProducer<Descriptor>::Create("BM_QueuePushPop");
+  static auto consumer = QueueConsumer<Descriptor>::Create("BM_QueuePushPop");
+  if (producer == nullptr || consumer == nullptr) {
+    state.SkipWithError("Could not create queue");
+    return;
+  }
+
+  std::array<Descriptor, kMaxQueueBatch> in;
+  std::array<Descriptor, kMaxQueueBatch> out;
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    in[i] = {i * 64ul, 64, i};
+  }
+
+  for (auto _ : state) {
+    if (use_batch) {
+      producer->PushBatch(in.data(), batch_size);
+      benchmark::DoNotOptimize(consumer->PopBatch(out.data(), batch_size));
+    } else {
+      for (uint32_t i = 0; i < batch_size; ++i) {
+        producer->Push(in[i]);
+      }
+      for (uint32_t i = 0; i < batch_size; ++i) {
+        out[i] = consumer->Pop().value();
+      }
+    }
+    benchmark::DoNotOptimize(out);
+  }
+
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_QueuePushPop)
+    ->ArgsProduct({{1, 8, 32}, {0, 1}})
+    ->ArgNames({"batch", "batched_api"});
+
+// Same as `BM_QueuePushPop` with the per-element API, but for the MPMC queue.
+// Args: {elements per batch}.
+static void BM_MpmcQueuePushPop(benchmark::State& state) {
+  uint32_t batch_size = state.range(0);
+
+  static auto consumer =
+      MpmcQueueConsumer<Descriptor>::Create("BM_MpmcQueuePushPop");
+  static auto producer =
+      MpmcQueueProducer<Descriptor>::Create("BM_MpmcQueuePushPop");
+  if (producer == nullptr || consumer == nullptr) {
+    state.SkipWithError("Could not create queue");
+    return;
+  }
+
+  std::array<Descriptor, kMaxQueueBatch> in;
+  std::array<Descriptor, kMaxQueueBatch> out;
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    in[i] = {i * 64ul, 64, i};
+  }
+
+  for (auto _ : state) {
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      producer->Push(in[i]);
+    }
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      out[i] = consumer->Pop().value();
+    }
+    benchmark::DoNotOptimize(out);
+  }
+
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_MpmcQueuePushPop)->Arg(1)->Arg(8)->Arg(32)->ArgName("batch");
+
+// Args: {record size in bytes}.
+static void BM_ByteQueuePushPop(benchmark::State& state) {
+  uint32_t record_size = state.range(0);
+
+  static auto producer = ByteQueueProducer::Create("BM_ByteQueuePushPop");
+  static auto consumer = ByteQueueConsumer::Create("BM_ByteQueuePushPop");
+  if (producer == nullptr || consumer == nullptr) {
+    state.SkipWithError("Could not create queue");
+    return;
+  }
+
+  std::vector<uint8_t> in(record_size, 1);
+  std::vector<uint8_t> out(record_size);
+
+  for (auto _ : state) {
+    producer->Push(in.data(), record_size);
+    uint32_t nb_bytes = 0;
+    uint8_t* data = consumer->Peek(&nb_bytes);
+    memcpy(out.data(), data, nb_bytes);
+    consumer->Release();
+    benchmark::DoNotOptimize(out.data());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * record_size);
+}
+BENCHMARK(BM_ByteQueuePushPop)->Arg(56)->Arg(256)->Arg(1500)->ArgName("size");
+
+// Same as `BM_ByteQueuePushPop` but splitting records into queue elements.
+// Args: {record size in bytes}.
+static void BM_ChunkedQueuePushPop(benchmark::State& state) {
+  using Chunk = std::array<uint8_t, 56>;
+  uint32_t record_size = state.range(0);
+  uint32_t nb_chunks = (record_size + sizeof(Chunk) - 1) / sizeof(Chunk);
+
+  static auto producer = QueueProducer<Chunk>::Create("BM_ChunkedQueue");
+  static auto consumer = QueueConsumer<Chunk>::Create("BM_ChunkedQueue");
+  if (producer == nullptr || consumer == nullptr) {
+    state.SkipWithError("Could not create queue");
+    return;
+  }
+
+  std::vector<Chunk> in(nb_chunks);
+  std::vector<Chunk> out(nb_chunks);
+
+  for (auto _ : state) {
+    producer->PushBatch(in.data(), nb_chunks);
+    consumer->PopBatch(out.data(), nb_chunks);
+    benchmark::DoNotOptimize(out.data());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * record_size);
+}
+BENCHMARK(BM_ChunkedQueuePushPop)
+    ->Arg(56)
+    ->Arg(256)
+    ->Arg(1500)
+    ->ArgName("size");
+
+}  // namespace bench
+}  // namespace enso
+
+BENCHMARK_MAIN();
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Benchmarks comparing the SIMD kernels for every instruction set
+ *        (`simd.h`).
+ *
+ * Kernels for instruction sets that the CPU does not support are skipped. Code
+ * that is inlined in the fast path, such as `QueueProducer::Push()`, uses the
+ * instruction set targeted at compile time, compare it by building
+ * `queue_bench` with different `-march` values.
+ */
+
+#include <benchmark/benchmark.h>
+#include <enso/helpers.h>
+#include <enso/simd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace enso {
+namespace bench {
+
+using CopyFn = void (*)(void*, const void*, size_t);
+
+// What applications get: inlined for small copies, dispatched to the best
+// kernel for larger ones.
+static void memcpy_64_align_dispatched(void* dst, const void* src, size_t n) {
+  memcpy_64_align(dst, src, n);
+}
+
+// Args: {bytes to copy}.
+template <SimdIsa kIsa, CopyFn kCopy>
+static void BM_Memcpy64Align(benchmark::State& state) {
+  if (cpu_simd_isa() < kIsa) {
+    state.SkipWithError("Instruction set not supported by this CPU");
+    return;
+  }
+
+  size_t size = state.range(0);
+  uint8_t* src = (uint8_t*)aligned_alloc(64, size);
+  uint8_t* dst = (uint8_t*)aligned_alloc(64, size);
+  if (src == nullptr || dst == nullptr) {
+    free(src);
+    free(dst);
+    state.SkipWithError("Could not allocate buffers");
+    return;
+  }
+  memset(src, 1, size);
+  memset(dst, 0, size);
+
+  for (auto _ : state) {
+    kCopy(dst, src, size);
+    benchmark::ClobberMemory();
+  }
+
+  state.SetBytesProcessed(state.iterations() * size);
+
+  free(src);
+  free(dst);
+}
+BENCHMARK_TEMPLATE(BM_Memcpy64Align, SimdIsa::kSse2, memcpy_64_align_sse2)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->ArgName("size");
+BENCHMARK_TEMPLATE(BM_Memcpy64Align, SimdIsa::kAvx2, memcpy_64_align_avx2)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->ArgName("size");
+BENCHMARK_TEMPLATE(BM_Memcpy64Align, SimdIsa::kAvx512, memcpy_64_align_avx512)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->ArgName("size");
+BENCHMARK_TEMPLATE(BM_Memcpy64Align, SimdIsa::kSse2,
+                   memcpy_64_align_dispatched)
+    ->RangeMultiplier(4)
+    ->Range(64, 16384)
+    ->ArgName("size");
+
+}  // namespace bench
+}  // namespace enso
+
+BENCHMARK_MAIN();
@@ -55,6 +55,7 @@ void run_echo_event(uint32_t nb_queues, uint32_t core_id, uint32_t nb_cycles,
 
   using enso::Device;
   using enso::RxTxPipe;
+  using enso::Waiter;
 
   std::unique_ptr<Device> dev = Device::Create();
   std::vector<RxTxPipe*> pipes;
@@ -78,12 +79,16 @@ void run_echo_event(uint32_t nb_queues, uint32_t core_id, uint32_t nb_cycles,
 
   setup_done = true;
 
+  Waiter waiter;
+
   while (keep_running) {
     RxTxPipe* pipe = dev->NextRxTxPipeToRecv();
 
     if (unlikely(pipe == nullptr)) {
+      dev->WaitForRx(&waiter);
       continue;
     }
+    waiter.Reset();
 
     auto batch = pipe->PeekPkts();
 
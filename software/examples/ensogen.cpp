@@ -424,10 +424,13 @@ static uint64_t virt_to_phys(void* virt) {
 }
 
 struct EnsoPipe {
-  EnsoPipe(uint8_t* buf, uint32_t length, uint32_t good_bytes, uint32_t nb_pkts)
-      : buf(buf), length(length), good_bytes(good_bytes), nb_pkts(nb_pkts) {
-    phys_addr = virt_to_phys(buf);
-  }
+  EnsoPipe(uint8_t* buf, uint64_t phys_addr, uint32_t length,
+           uint32_t good_bytes, uint32_t nb_pkts)
+      : buf(buf),
+        length(length),
+        good_bytes(good_bytes),
+        nb_pkts(nb_pkts),
+        phys_addr(phys_addr) {}
   uint8_t* buf;
   uint32_t length;
   uint32_t good_bytes;
@@ -557,6 +560,7 @@ void pcap_pkt_handler(u_char* user, const struct pcap_pkthdr* pkt_hdr,
 
   if (nb_flits > context->free_flits) {
     uint8_t* buf;
+    uint64_t phys_addr;
     if ((context->hugepage_offset + BUFFER_SIZE) > HUGEPAGE_SIZE) {
       // Need to allocate another huge page.
       buf = (uint8_t*)get_huge_page(HUGEPAGE_SIZE);
@@ -564,13 +568,17 @@ void pcap_pkt_handler(u_char* user, const struct pcap_pkthdr* pkt_hdr,
         pcap_breakloop(context->pcap);
         return;
       }
+      // Huge pages are physically contiguous, so we only need to translate
+      // the address once per page.
+      phys_addr = virt_to_phys(buf);
       context->hugepage_offset = BUFFER_SIZE;
     } else {
       struct EnsoPipe& enso_pipe = context->enso_pipes.back();
       buf = enso_pipe.buf + BUFFER_SIZE;
+      phys_addr = enso_pipe.phys_addr + BUFFER_SIZE;
       context->hugepage_offset += BUFFER_SIZE;
     }
-    context->enso_pipes.emplace_back(buf, 0, 0, 0);
+    context->enso_pipes.emplace_back(buf, phys_addr, 0, 0, 0);
     context->free_flits = BUFFER_SIZE / 64;
   }
 
@@ -55,7 +55,7 @@ void run_forward(uint32_t nb_queues, enso::stats_t* stats) {
 
   using enso::Device;
   using enso::RxPipe;
-  using enso::TxPipe;
+  using enso::Waiter;
 
   std::unique_ptr<Device> dev = Device::Create();
   std::vector<RxPipe*> rx_pipes;
@@ -75,46 +75,34 @@ void run_forward(uint32_t nb_queues, enso::stats_t* stats) {
     rx_pipes.push_back(rx_pipe);
   }
 
-  TxPipe* tx_pipe = dev->AllocateTxPipe();
-  if (!tx_pipe) {
-    std::cerr << "Problem creating TX pipe" << std::endl;
-    exit(3);
-  }
-
   setup_done = true;
 
+  Waiter waiter;
+
   while (keep_running) {
+    // Free the RX bytes that were already sent.
+    dev->ProcessCompletions();
+
     RxPipe* rx_pipe = dev->NextRxPipeToRecv();
 
     if (unlikely(rx_pipe == nullptr)) {
+      dev->WaitForRx(&waiter);
       continue;
     }
+    waiter.Reset();
 
     auto batch = rx_pipe->PeekPkts();
 
-    uint8_t* tx_buf = tx_pipe->AllocateBuf(batch.available_bytes());
-
     for (auto pkt : batch) {
-      // Align packet length to 64 bytes.
-      uint16_t pkt_len = enso::get_pkt_len(pkt);
-      uint16_t pkt_len_64 = ((pkt_len - 1) / 64 + 1) * 64;
-      const struct ether_header* l2_hdr = (struct ether_header*)pkt;
-
-      struct ether_addr original_src_mac =
-          *((struct ether_addr*)l2_hdr->ether_shost);
-      struct ether_addr original_dst_mac =
-          *((struct ether_addr*)l2_hdr->ether_dhost);
-
-      // Forward packet to TX.
-      enso::memcpy_64_align(tx_buf, pkt, pkt_len_64);
-      l2_hdr = (struct ether_header*)tx_buf;
-      struct ether_addr* new_src_mac = (struct ether_addr*)l2_hdr->ether_shost;
-      struct ether_addr* new_dst_mac = (struct ether_addr*)l2_hdr->ether_dhost;
-
-      *new_src_mac = original_dst_mac;
-      *new_dst_mac = original_src_mac;
-
-      tx_buf += pkt_len_64;
+      struct ether_header* l2_hdr = (struct ether_header*)pkt;
+      struct ether_addr* src_mac = (struct ether_addr*)l2_hdr->ether_shost;
+      struct ether_addr* dst_mac = (struct ether_addr*)l2_hdr->ether_dhost;
+
+      // Swap MACs in place, the packet is sent from the RX pipe itself.
+      struct ether_addr original_src_mac = *src_mac;
+      *src_mac = *dst_mac;
+      *dst_mac = original_src_mac;
+
       ++(stats->nb_pkts);
     }
     uint32_t batch_length = batch.processed_bytes();
@@ -123,9 +111,11 @@ void run_forward(uint32_t nb_queues, enso::stats_t* stats) {
     stats->recv_bytes += batch_length;
     ++(stats->nb_batches);
 
-    rx_pipe->Clear();
-
-    tx_pipe->SendAndFree(batch_length);
+    // Bytes are freed from the RX pipe once they are sent. If they cannot be
+    // forwarded, they are dropped.
+    if (dev->ForwardAndFree(rx_pipe, batch.buf(), batch_length)) {
+      rx_pipe->FreeRange(batch.buf(), batch_length);
+    }
   }
 }
 
@@ -73,6 +73,16 @@ constexpr uint32_t kMaxTransferLen = 131072;
 // Maximum number of tails to process at once.
 constexpr uint32_t kBatchSize = 64;
 
+// Size of the ring with the next notifications to be consumed from a
+// notification buffer. Every call to `get_new_tails` adds at most `kBatchSize`
+// notifications to it.
+constexpr uint32_t kNextRxNotifsSize = 4 * kBatchSize;
+static_assert((kNextRxNotifsSize & (kNextRxNotifsSize - 1)) == 0,
+              "kNextRxNotifsSize must be a power of 2");
+
+// Returned when looking up the slot of a pipe that is not enabled.
+constexpr uint32_t kInvalidRxPipeSlot = 0xffffffff;
+
 #ifndef NOTIFICATION_BUF_SIZE
 // This should be the max buffer supported by the hardware, we may override this
 // value when compiling. It is defined in number of flits (64 bytes).
@@ -87,8 +97,23 @@ constexpr uint32_t kNotificationBufSize = NOTIFICATION_BUF_SIZE;
 #endif
 constexpr uint32_t kEnsoPipeSize = ENSO_PIPE_SIZE;
 
+// Range of pipe sizes that may be requested when allocating a pipe (in number
+// of flits). Sizes must also be a power of two. Pipes that are not
+// `kEnsoPipeSize` flits in size may not be supported by every backend.
+constexpr uint32_t kMinEnsoPipeSize = 64;
+constexpr uint32_t kMaxEnsoPipeSize = 1UL << 20;
+
+// Maximum number of freed flits that an RX pipe of the default size may
+// accumulate before it reports its new head to the NIC (half of the pipe). See
+// `RxPipe::SetHeadUpdateThreshold`.
+constexpr uint32_t kMaxHeadUpdateThreshold = kEnsoPipeSize / 2;
+
 constexpr uint32_t kMaxPendingTxRequests = kNotificationBufSize - 1;
 
+// Maximum number of TX notifications that a Device may queue before it writes
+// the new tail to the NIC. See `Device::EnableDeferredTxDoorbell`.
+constexpr uint32_t kMaxTxFlushThreshold = kNotificationBufSize / 2;
+
 // Using 2MB huge pages (size in bytes).
 constexpr uint32_t kBufPageSize = 1UL << 21;
 
@@ -97,18 +122,17 @@ static constexpr std::string_view kHugePageDefaultPrefix = "/mnt/huge/enso";
 static constexpr std::string_view kHugePageRxPipePathPrefix = "_rx_pipe:";
 static constexpr std::string_view kHugePagePathPrefix = "_tx_pipe:";
 static constexpr std::string_view kHugePageNotifBufPathPrefix = "_notif_buf:";
+static constexpr std::string_view kHugePagePipeArenaPathPrefix = "_pipe_arena:";
 static constexpr std::string_view kHugePageQueuePathPrefix = "_queue:";
+static constexpr std::string_view kHugePageByteQueuePathPrefix = "_byte_queue:";
 static constexpr std::string_view kHugePageUthreadsPathPrefix = "_uthread:";
 static constexpr std::string_view kHugePageKthreadsPathPrefix = "_kthread:";
 static constexpr std::string_view kHugePageQueueTailPathPrefix = "_queue_tail";
 static constexpr std::string_view kHugePageQueueHeadPathPrefix = "_queue_head";
 
 // We need this to allow the same huge page to be mapped to adjacent memory
-// regions.
-// TODO(sadok): support other buffer sizes. It may be possible to support
-// other buffer sizes by overlaying regular pages on top of the huge pages.
-// We might use those only for requests that overlap to avoid adding too
-// many entries to the TLB.
+// regions. Pipes of other sizes can still be requested at runtime, this only
+// applies to the default size, which is also used by TX pipes.
 static_assert(ENSO_PIPE_SIZE * 64 == kBufPageSize, "Unsupported buffer size");
 
 /**
@@ -0,0 +1,617 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Performance-critical parts of the notification buffer and pipe logic.
+ *
+ * These functions are used both by the library and by the inline methods in
+ * `pipe.h`, so that the receive and send paths can be inlined into the
+ * application without relying on link-time optimization. Functions that write
+ * to device registers are templated on a type that provides a static
+ * `mmio_write32()`. The library uses the backend's `DevBackend`, while
+ * `pipe.h` uses `FastPathMmio`.
+ *
+ * Hooks called from the fast path are also template parameters, so that they
+ * can be inlined or compiled out entirely. Each hook has a policy that calls
+ * the `std::function` callbacks set at runtime, e.g., with
+ * `Device::InitializeBackend()`.
+ *
+ * This header is internal to Enso and should not be used by applications
+ * directly.
+ */
+
+#ifndef ENSO_SOFTWARE_INCLUDE_ENSO_FAST_PATH_H_
+#define ENSO_SOFTWARE_INCLUDE_ENSO_FAST_PATH_H_
+
+#include <enso/consts.h>
+#include <enso/helpers.h>
+#include <enso/internals.h>
+#include <enso/simd.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace enso {
+
+/**
+ * @brief Gets the slot assigned to the Enso Pipe with the given ID.
+ *
+ * @param notification_buf_pair Notification buffer pair to use.
+ * @param enso_pipe_id Hardware ID of the Enso Pipe.
+ * @return The slot or `kInvalidRxPipeSlot` if the pipe has no slot.
+ */
+_enso_always_inline uint32_t
+get_rx_pipe_slot(const struct NotificationBufPair* notification_buf_pair,
+                 enso_pipe_id_t enso_pipe_id) {
+  const struct RxPipeSlotMapEntry* slot_map =
+      notification_buf_pair->rx_pipe_slot_map;
+  uint32_t mask = notification_buf_pair->rx_pipe_slot_map_mask;
+
+  // The map is never more than half full, so the probe always terminates and
+  // usually stops at the first entry.
+  for (uint32_t i = enso_pipe_id & mask;; i = (i + 1) & mask) {
+    const struct RxPipeSlotMapEntry* entry = &slot_map[i];
+    if (likely(entry->enso_pipe_id == enso_pipe_id)) {
+      return entry->slot;
+    }
+    if (entry->enso_pipe_id == kInvalidRxPipeSlot) {
+      return kInvalidRxPipeSlot;
+    }
+  }
+}
+
+/**
+ * @brief Updates the tx head and the number of TX completions.
+ *
+ * @param notification_buf_pair Notification buffer to be updated.
+ */
+void update_tx_head(struct NotificationBufPair* notification_buf_pair);
+
+namespace fast_path {
+
+/**
+ * @brief Writes to a device register with the backend's `mmio_write32()`.
+ *
+ * Out of line, for backends whose register writes cannot be inlined into the
+ * application.
+ */
+void library_mmio_write32(volatile uint32_t* addr, uint32_t value,
+                          void* uio_mmap_bar2_addr);
+
+/**
+ * @brief Park policy that calls the park callback set at runtime, if any.
+ */
+struct CallbackPark {
+  static void park();
+};
+
+/**
+ * @brief Park policy that busy waits, e.g., for applications with dedicated
+ *        cores. May be given to `Device::Send()` and `TxPipe::SendAndFree()`.
+ */
+struct SpinPark {
+  static _enso_always_inline void park() {}
+};
+
+/**
+ * @brief Update policy for `get_new_tails()` that does nothing, letting the
+ *        compiler remove the per-notification hook.
+ *
+ * Any callable with the signature of `UpdatePacket` may be used instead. A
+ * `UpdatePacket` is only called if it is set.
+ */
+struct NoUpdatePacket {
+  constexpr explicit operator bool() const { return false; }
+  constexpr void operator()(enso_pipe_id_t, uint64_t, uint32_t) const {}
+};
+
+/**
+ * @brief Returns whether the given hook should be called. Hooks that can be
+ *        converted to `bool` (e.g., `std::function`) are checked.
+ */
+template <typename Hook>
+_enso_always_inline constexpr bool is_hook_set(const Hook& hook) {
+  if constexpr (std::is_constructible_v<bool, const Hook&>) {
+    return static_cast<bool>(hook);
+  } else {
+    return true;
+  }
+}
+
+/**
+ * @brief Blocks until the device frees at least one TX notification.
+ *
+ * `notification_buf_pair->tx_tail` must be up to date.
+ *
+ * @tparam Park Policy called while waiting.
+ * @return Number of free TX notifications.
+ */
+template <typename Park>
+inline uint32_t wait_for_free_tx_notifs(
+    struct NotificationBufPair* notification_buf_pair) {
+  uint32_t tx_tail = notification_buf_pair->tx_tail;
+  uint32_t free_slots =
+      (notification_buf_pair->tx_head - tx_tail - 1) % kNotificationBufSize;
+  while (unlikely(free_slots == 0)) {
+    ++notification_buf_pair->tx_full_cnt;
+    Park::park();
+    update_tx_head(notification_buf_pair);
+    free_slots =
+        (notification_buf_pair->tx_head - tx_tail - 1) % kNotificationBufSize;
+  }
+  return free_slots;
+}
+
+/**
+ * @brief Register writes as plain stores.
+ *
+ * The fast path only writes to head and tail registers, which are mapped
+ * directly to the device by every backend except the hybrid one.
+ */
+struct DirectMmio {
+  static _enso_always_inline void mmio_write32(volatile uint32_t* addr,
+                                               uint32_t value,
+                                               void* uio_mmap_bar2_addr) {
+    (void)uio_mmap_bar2_addr;
+    _enso_compiler_memory_barrier();
+    *addr = value;
+  }
+};
+
+/**
+ * @brief Register writes that go through the library.
+ */
+struct LibraryMmio {
+  static _enso_always_inline void mmio_write32(volatile uint32_t* addr,
+                                               uint32_t value,
+                                               void* uio_mmap_bar2_addr) {
+    library_mmio_write32(addr, value, uio_mmap_bar2_addr);
+  }
+};
+
+// The hybrid backend forwards every register write to another process, which
+// only the library knows how to do.
+#ifdef ENSO_INDIRECT_MMIO
+using FastPathMmio = LibraryMmio;
+#else
+using FastPathMmio = DirectMmio;
+#endif  // ENSO_INDIRECT_MMIO
+
+#ifdef VECTORIZED_NOTIF_SCAN
+/**
+ * @brief Consumes up to 8 consecutive notifications at once.
+ *
+ * Signals are checked with a single gather and only the notifications before
+ * the first one that is not set are consumed. The caller must ensure that
+ * neither the notification buffer nor the `next_rx_pipe_notifs` ring wraps
+ * around within the next 8 entries. Needs AVX-512, the caller must check
+ * `simd_isa()`.
+ *
+ * @param nb_new_rx_notifs Set to the number of notifications added to the
+ *                         `next_rx_pipe_notifs` ring. Notifications for pipes
+ *                         without a slot are consumed but not added.
+ * @return Number of notifications consumed (up to 8).
+ */
+_enso_avx512_kernel uint16_t
+get_new_tails_x8(struct NotificationBufPair* notification_buf_pair,
+                 uint32_t notification_buf_head, uint16_t next_rx_ids_tail,
+                 uint16_t* nb_new_rx_notifs) {
+  static_assert(sizeof(struct RxNotification) == 64,
+                "Gather offsets assume 64-byte notifications");
+
+  struct RxNotification* first_notification =
+      notification_buf_pair->rx_buf + notification_buf_head;
+  uint8_t* base = (uint8_t*)first_notification;
+
+  const __m512i offsets = _mm512_set_epi64(448, 384, 320, 256, 192, 128, 64, 0);
+  const __m512i zero = _mm512_setzero_si512();
+
+  // Masked gathers with an explicit source avoid a spurious
+  // -Wmaybe-uninitialized from the unmasked intrinsics in some GCC versions.
+  __m512i signals = _mm512_mask_i64gather_epi64(
+      zero, 0xFF, offsets, base + offsetof(struct RxNotification, signal), 1);
+  __mmask8 set_signals = _mm512_test_epi64_mask(signals, signals);
+
+  // Notifications must be consumed in order, stop at the first unset signal.
+  uint16_t nb_notifications = _tzcnt_u32(~(uint32_t)set_signals);
+  if (nb_notifications == 0) {
+    *nb_new_rx_notifs = 0;
+    return 0;
+  }
+  __mmask8 mask = (__mmask8)((1U << nb_notifications) - 1);
+
+  // Pipe IDs are translated to slots one by one, the map lookup does not
+  // vectorize well and usually hits on the first probe.
+  alignas(64) uint64_t slots[8];
+  __mmask8 valid = 0;
+  for (uint16_t i = 0; i < nb_notifications; ++i) {
+    enso_pipe_id_t enso_pipe_id = first_notification[i].queue_id;
+    slots[i] = get_rx_pipe_slot(notification_buf_pair, enso_pipe_id);
+    valid |= (__mmask8)((slots[i] != kInvalidRxPipeSlot) << i);
+  }
+  __m512i slot_idxs = _mm512_maskz_load_epi64(valid, slots);
+  __m512i tails = _mm512_mask_i64gather_epi64(
+      zero, valid, offsets, base + offsetof(struct RxNotification, tail), 1);
+
+  // Scatters to overlapping indices are ordered from the least to the most
+  // significant element. If a pipe shows up more than once, the most recent
+  // tail wins, just like in the scalar loop.
+  _mm512_mask_i64scatter_epi32(
+      &notification_buf_pair->rx_pipe_slots->pending_tail, valid, slot_idxs,
+      _mm512_maskz_cvtepi64_epi32(valid, tails), sizeof(struct RxPipeSlot));
+
+  // We use regular rather than streaming stores to clear the signals: these
+  // notifications are read again when the pipes are consumed, so we want them
+  // to stay in the cache.
+  _mm512_mask_i64scatter_epi64(base + offsetof(struct RxNotification, signal),
+                               mask, offsets, zero, 1);
+
+  __m512i notification_addrs =
+      _mm512_add_epi64(_mm512_set1_epi64((int64_t)base), offsets);
+  _mm512_mask_compressstoreu_epi64(
+      notification_buf_pair->next_rx_pipe_notifs + next_rx_ids_tail, valid,
+      notification_addrs);
+  *nb_new_rx_notifs = _mm_popcnt_u32(valid);
+
+  return nb_notifications;
+}
+#endif  // VECTORIZED_NOTIF_SCAN
+
+/**
+ * @brief Updates bookkeeping on until where packets are
+ *        available for each enso RX pipe, adds to ring buffer with
+ *        next notifications to consume.
+ *
+ * @tparam UpdateFn Called for every notification with the pipe ID, the
+ *                  notification's timestamp and the pipe's previous tail.
+ *
+ * @param notification_buf_pair
+ * @return Number of consumed notifications.
+ */
+template <typename Mmio, typename UpdateFn = NoUpdatePacket>
+_enso_always_inline uint16_t
+get_new_tails(struct NotificationBufPair* notification_buf_pair,
+              const UpdateFn& update_packet = UpdateFn()) {
+  struct RxNotification* notification_buf = notification_buf_pair->rx_buf;
+  uint32_t notification_buf_head = notification_buf_pair->rx_head;
+  uint16_t nb_consumed_notifications = 0;
+
+  uint16_t next_rx_ids_tail = notification_buf_pair->next_rx_ids_tail;
+  constexpr uint16_t kNextRxNotifsMask = kNextRxNotifsSize - 1;
+
+  // Notifications are only removed from the ring by `get_next_rx_notif` and
+  // `Device::NextRxPipesToRecv`. Applications that only receive from specific
+  // pipes never consume it, so we drop the oldest entries to make room for
+  // this batch. The pipes' tails are still updated, so no data is lost.
+  constexpr uint16_t kMaxPendingRxNotifs = kNextRxNotifsSize - 1 - kBatchSize;
+  uint16_t next_rx_ids_head = notification_buf_pair->next_rx_ids_head;
+  if (unlikely(((next_rx_ids_tail - next_rx_ids_head) & kNextRxNotifsMask) >
+               kMaxPendingRxNotifs)) {
+    notification_buf_pair->next_rx_ids_head =
+        (next_rx_ids_tail - kMaxPendingRxNotifs) & kNextRxNotifsMask;
+  }
+
+  bool coalesce_notifs = notification_buf_pair->coalesce_notifs;
+  uint32_t notif_gen = 0;
+  if (coalesce_notifs) {
+    notif_gen = ++(notification_buf_pair->notif_gen);
+    if (unlikely(notif_gen == 0)) {
+      // Generation wrapped around, forget about all previous generations.
+      struct RxPipeSlot* rx_pipe_slots = notification_buf_pair->rx_pipe_slots;
+      for (uint32_t i = 0; i < notification_buf_pair->nb_rx_pipe_slots; ++i) {
+        rx_pipe_slots[i].notif_gen = 0;
+      }
+      notif_gen = notification_buf_pair->notif_gen = 1;
+    }
+  }
+
+#ifdef VECTORIZED_NOTIF_SCAN
+  // The vectorized path cannot call `update_packet` in between notifications,
+  // does not coalesce notifications, and does not handle wrap arounds.
+  // Everything else, as well as CPUs without AVX-512, falls back to the scalar
+  // loop below.
+  if (!is_hook_set(update_packet) && !coalesce_notifs &&
+      simd_isa() == SimdIsa::kAvx512) {
+    while (nb_consumed_notifications + 8U <= kBatchSize &&
+           notification_buf_head + 8U <= kNotificationBufSize &&
+           next_rx_ids_tail + 8U <= kNextRxNotifsSize) {
+      uint16_t nb_new_rx_notifs;
+      uint16_t nb_notifications =
+          get_new_tails_x8(notification_buf_pair, notification_buf_head,
+                           next_rx_ids_tail, &nb_new_rx_notifs);
+      nb_consumed_notifications += nb_notifications;
+      notification_buf_head += nb_notifications;
+      next_rx_ids_tail += nb_new_rx_notifs;
+      if (nb_notifications < 8) {
+        break;
+      }
+    }
+    notification_buf_head %= kNotificationBufSize;
+    next_rx_ids_tail &= kNextRxNotifsMask;
+  }
+#endif  // VECTORIZED_NOTIF_SCAN
+
+  for (uint16_t i = nb_consumed_notifications; i < kBatchSize; ++i) {
+    struct RxNotification* cur_notification =
+        notification_buf + notification_buf_head;
+
+    // Check if the next notification was updated by the NIC.
+    if (!cur_notification->signal) {
+      break;
+    }
+
+    enso_pipe_id_t enso_pipe_id = cur_notification->queue_id;
+    uint32_t slot = get_rx_pipe_slot(notification_buf_pair, enso_pipe_id);
+
+    cur_notification->signal = 0;
+
+    notification_buf_head = (notification_buf_head + 1) % kNotificationBufSize;
+
+    ++nb_consumed_notifications;
+
+    // The pipe may have been freed after the NIC sent the notification.
+    if (unlikely(slot == kInvalidRxPipeSlot)) {
+      continue;
+    }
+
+    /* Update the packet sent time in the packet itself */
+    if (is_hook_set(update_packet)) {
+      std::invoke(update_packet, enso_pipe_id,
+                  (uint64_t)cur_notification->pad[1],
+                  notification_buf_pair->rx_pipe_slots[slot].pending_tail);
+    }
+
+    /* Must update the corresponding packet in the RX Pipe with the sent time
+     * timestamp */
+
+    notification_buf_pair->rx_pipe_slots[slot].pending_tail =
+        (uint32_t)cur_notification->tail;
+
+    // When coalescing, the pipe is already in next_rx_pipe_notifs if it
+    // received another notification in this burst. The tail we just updated is
+    // enough for it to consume everything once it's visited.
+    if (coalesce_notifs) {
+      if (notification_buf_pair->rx_pipe_slots[slot].notif_gen == notif_gen) {
+        continue;
+      }
+      notification_buf_pair->rx_pipe_slots[slot].notif_gen = notif_gen;
+    }
+
+    // orders the new updates: read pipes from next_rx_ids_head to
+    // next_rx_ids_tail
+    notification_buf_pair->next_rx_pipe_notifs[next_rx_ids_tail] =
+        cur_notification;
+    next_rx_ids_tail = (next_rx_ids_tail + 1) & kNextRxNotifsMask;
+  }
+
+  notification_buf_pair->next_rx_ids_tail = next_rx_ids_tail;
+
+  if (likely(nb_consumed_notifications > 0)) {
+    Mmio::mmio_write32(notification_buf_pair->rx_head_ptr,
+                       notification_buf_head,
+                       notification_buf_pair->uio_mmap_bar2_addr);
+    notification_buf_pair->rx_head = notification_buf_head;
+  }
+
+  return nb_consumed_notifications;
+}
+
+/**
+ * @brief Gets the data that arrived at the given Enso Pipe since the last
+ *        call.
+ *
+ * @param enso_pipe Enso Pipe to get data from.
+ * @param notification_buf_pair Notification buffer pair of the pipe.
+ * @param buf Set to point to the data.
+ * @param peek Whether to keep the data in the pipe, so that the next call
+ *             returns it again.
+ * @return Number of bytes available.
+ */
+_enso_always_inline uint32_t
+consume_queue(struct RxEnsoPipeInternal* enso_pipe,
+              struct NotificationBufPair* notification_buf_pair, void** buf,
+              bool peek = false) {
+  uint32_t* enso_pipe_buf = enso_pipe->buf;
+  uint32_t enso_pipe_head = enso_pipe->rx_tail;
+
+  *buf = &enso_pipe_buf[enso_pipe_head * 16];
+
+  uint32_t enso_pipe_tail =
+      notification_buf_pair->rx_pipe_slots[enso_pipe->slot].pending_tail;
+
+  if (enso_pipe_tail == enso_pipe_head) {
+    return 0;
+  }
+
+  uint32_t mask = enso_pipe->mask;
+  uint32_t flit_aligned_size = ((enso_pipe_tail - enso_pipe_head) & mask) * 64;
+
+  if (!peek) {
+    enso_pipe_head = (enso_pipe_head + flit_aligned_size / 64) & mask;
+    enso_pipe->rx_tail = enso_pipe_head;
+  }
+
+  return flit_aligned_size;
+}
+
+/**
+ * @brief Tells the device about the current head of the given Enso Pipe.
+ */
+template <typename Mmio>
+_enso_always_inline void report_pipe_head(
+    struct RxEnsoPipeInternal* enso_pipe) {
+  Mmio::mmio_write32(enso_pipe->buf_head_ptr, enso_pipe->rx_head,
+                     enso_pipe->uio_mmap_bar2_addr);
+  enso_pipe->last_reported_head = enso_pipe->rx_head;
+}
+
+/**
+ * @brief Sets the head of the given Enso Pipe, telling the device about it
+ *        once enough flits were freed.
+ */
+template <typename Mmio>
+_enso_always_inline void update_pipe_head(struct RxEnsoPipeInternal* enso_pipe,
+                                          uint32_t rx_head) {
+  enso_pipe->rx_head = rx_head;
+
+  uint32_t mask = enso_pipe->mask;
+  uint32_t last_reported_head = enso_pipe->last_reported_head;
+  uint32_t nb_unreported_flits = (rx_head - last_reported_head) & mask;
+
+  // From the NIC's perspective, everything after the last reported head is
+  // still in use. Report the new head if we accumulated enough freed flits or
+  // if the pipe looks at least half full to the NIC, so that it never stalls
+  // waiting for space that we already freed.
+  uint32_t nb_flits_in_use = (enso_pipe->rx_tail - last_reported_head) & mask;
+  if (nb_unreported_flits >= enso_pipe->head_update_threshold ||
+      nb_flits_in_use > mask / 2) {
+    report_pipe_head<Mmio>(enso_pipe);
+  }
+}
+
+/**
+ * @brief Frees the next `len` bytes in the given Enso Pipe.
+ */
+template <typename Mmio>
+_enso_always_inline void advance_pipe(struct RxEnsoPipeInternal* enso_pipe,
+                                      size_t len) {
+  uint32_t rx_pkt_head = enso_pipe->rx_head;
+  uint32_t nb_flits = ((uint64_t)len - 1) / 64 + 1;
+  rx_pkt_head = (rx_pkt_head + nb_flits) & enso_pipe->mask;
+
+  update_pipe_head<Mmio>(enso_pipe, rx_pkt_head);
+}
+
+/**
+ * @brief Frees all the data received by the given Enso Pipe.
+ */
+template <typename Mmio>
+_enso_always_inline void fully_advance_pipe(
+    struct RxEnsoPipeInternal* enso_pipe) {
+  update_pipe_head<Mmio>(enso_pipe, enso_pipe->rx_tail);
+}
+
+/**
+ * @brief Tells the device about TX notifications that were not reported yet.
+ */
+template <typename Mmio>
+_enso_always_inline void flush_tx(
+    struct NotificationBufPair* notification_buf_pair) {
+  uint32_t tx_tail = notification_buf_pair->tx_tail;
+  if (tx_tail != notification_buf_pair->tx_tail_reported) {
+    Mmio::mmio_write32(notification_buf_pair->tx_tail_ptr, tx_tail,
+                       notification_buf_pair->uio_mmap_bar2_addr);
+    notification_buf_pair->tx_tail_reported = tx_tail;
+  }
+}
+
+/**
+ * @brief Sends data through the given notification buffer pair, blocking
+ *        until there are enough free TX notifications.
+ *
+ * @param notification_buf_pair Notification buffer pair to use.
+ * @param phys_addr Physical address of the data.
+ * @param len Number of bytes to send.
+ * @param sent_time Value stored in the notifications' `pad[0]`.
+ * @return Number of bytes sent.
+ *
+ * @tparam Park Policy called while waiting for free TX notifications.
+ */
+template <typename Mmio, typename Park = CallbackPark>
+_enso_always_inline uint32_t
+send_to_queue(struct NotificationBufPair* notification_buf_pair,
+              uint64_t phys_addr, uint32_t len, uint64_t sent_time = 0) {
+  struct TxNotification* tx_buf = notification_buf_pair->tx_buf;
+  uint32_t tx_tail = notification_buf_pair->tx_tail;
+  uint32_t missing_bytes = len;
+
+  uint64_t transf_addr = phys_addr;
+  uint64_t hugepage_mask = ~((uint64_t)kBufPageSize - 1);
+  uint64_t hugepage_base_addr = transf_addr & hugepage_mask;
+  uint64_t hugepage_boundary = hugepage_base_addr + kBufPageSize;
+
+  while (missing_bytes > 0) {
+    uint32_t free_slots =
+        (notification_buf_pair->tx_head - tx_tail - 1) % kNotificationBufSize;
+
+    // Block until we can send.
+    if (unlikely(free_slots == 0)) {
+      // The NIC cannot free slots for notifications it has not seen yet.
+      notification_buf_pair->tx_tail = tx_tail;
+      flush_tx<Mmio>(notification_buf_pair);
+      free_slots = wait_for_free_tx_notifs<Park>(notification_buf_pair);
+    }
+
+    struct TxNotification* tx_notification = tx_buf + tx_tail;
+    uint32_t req_length = std::min(missing_bytes, (uint32_t)kMaxTransferLen);
+    uint32_t missing_bytes_in_page = hugepage_boundary - transf_addr;
+    req_length = std::min(req_length, missing_bytes_in_page);
+
+    // If the transmission needs to be split among multiple requests, we
+    // need to set a bit in the wrap tracker.
+    uint8_t wrap_tracker_mask = (missing_bytes > req_length) << (tx_tail & 0x7);
+    notification_buf_pair->wrap_tracker[tx_tail / 8] |= wrap_tracker_mask;
+
+    tx_notification->length = req_length;
+    tx_notification->phys_addr = transf_addr;
+    tx_notification->pad[0] = sent_time;
+    tx_notification->signal = 1;
+
+    uint64_t huge_page_offset = (transf_addr + req_length) % kBufPageSize;
+    transf_addr = hugepage_base_addr + huge_page_offset;
+
+    tx_tail = (tx_tail + 1) % kNotificationBufSize;
+    missing_bytes -= req_length;
+  }
+
+  notification_buf_pair->tx_tail = tx_tail;
+
+  uint32_t tx_tail_reported = notification_buf_pair->tx_tail_reported;
+  uint32_t nb_unreported_notifs =
+      (tx_tail - tx_tail_reported) % kNotificationBufSize;
+  if (nb_unreported_notifs >= notification_buf_pair->tx_tail_flush_threshold) {
+    Mmio::mmio_write32(notification_buf_pair->tx_tail_ptr, tx_tail,
+                       notification_buf_pair->uio_mmap_bar2_addr);
+    notification_buf_pair->tx_tail_reported = tx_tail;
+  }
+
+  return len;
+}
+
+}  // namespace fast_path
+
+}  // namespace enso
+
+#endif  // ENSO_SOFTWARE_INCLUDE_ENSO_FAST_PATH_H_
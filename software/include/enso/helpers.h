@@ -43,6 +43,7 @@
 #include <enso/consts.h>
 #include <enso/internals.h>
 #include <enso/ixy_helpers.h>
+#include <enso/simd.h>
 #include <immintrin.h>
 #include <netinet/ether.h>
 #include <netinet/in.h>
@@ -213,6 +214,9 @@ _enso_always_inline void mov64(uint8_t* dst, const uint8_t* src) {
 /**
  * @brief Copies data from src to dst.
  *
+ * Uses the best instruction set supported by the CPU, larger copies may call
+ * a kernel for an instruction set that the library was not built for.
+ *
  * @param dst Destination address.
  * @param src Source address.
  * @param n 64-byte aligned number of bytes to copy.
@@ -221,6 +225,19 @@ _enso_always_inline void memcpy_64_align(void* dst, const void* src, size_t n) {
   // Check that it is aligned to 64 bytes.
   assert(((uint64_t)dst & 0x3f) == 0);
 
+#if !defined __AVX512F__
+  // Calling a kernel only pays off if there is enough to copy.
+  constexpr size_t kMinDispatchSize = 256;
+  if (n >= kMinDispatchSize && simd_isa() > kCompiledSimdIsa) {
+    if (simd_isa() == SimdIsa::kAvx512) {
+      memcpy_64_align_avx512(dst, src, n);
+    } else {
+      memcpy_64_align_avx2(dst, src, n);
+    }
+    return;
+  }
+#endif  // __AVX512F__
+
   for (; n >= 64; n -= 64) {
     mov64((uint8_t*)dst, (const uint8_t*)src);
     dst = (uint8_t*)dst + 64;
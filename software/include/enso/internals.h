@@ -42,12 +42,16 @@
 #ifndef ENSO_SOFTWARE_INCLUDE_ENSO_INTERNALS_H_
 #define ENSO_SOFTWARE_INCLUDE_ENSO_INTERNALS_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 namespace enso {
 
+struct HugePageArena;
+
 #if MAX_NB_FLOWS < 65536
 using enso_pipe_id_t = uint16_t;
 #else
@@ -80,50 +84,112 @@ struct __attribute__((__packed__)) TxNotification {
   uint64_t pad[5];
 };
 
+struct RxPipeSlotMapEntry {
+  uint32_t enso_pipe_id;  // `kInvalidRxPipeSlot` if the entry is empty.
+  uint32_t slot;
+};
+
+// Per-pipe state kept by the notification buffer. The tail and the coalescing
+// generation of a pipe are used together, so they share a cache line.
+struct RxPipeSlot {
+  uint32_t pending_tail;  // Latest tail reported by the NIC.
+  uint32_t notif_gen;     // Last notif_gen in which the pipe was added.
+};
+
+// Fields are grouped by how often they are used. The RX section holds only what
+// is needed to consume notifications and to get the pipes' tails, the TX
+// section only what is needed to send data and to reap completions. Each one
+// fits in a single cache line.
 struct NotificationBufPair {
-  // First cache line:
-  struct RxNotification* rx_buf;
+  // RX hot section:
+  alignas(64) struct RxNotification* rx_buf;
   struct RxNotification**
       next_rx_pipe_notifs;  // Next pipe notifications to consume from rx_buf:
-                            // stored in ring buffer by next_rx_ids_head and
-                            // next_rx_ids_tail
-  struct TxNotification* tx_buf;
+                            // stored in ring buffer (of kNextRxNotifsSize) by
+                            // next_rx_ids_head and next_rx_ids_tail
   uint32_t* rx_head_ptr;
-  uint32_t* tx_tail_ptr;
+
+  // Per-pipe state is indexed by slot rather than by Enso Pipe ID, so that it
+  // only grows with the number of pipes enabled on this notification buffer.
+  // `rx_pipe_slot_map` is a small open addressing hash table that maps the ID
+  // of every enabled pipe to its slot.
+  struct RxPipeSlotMapEntry* rx_pipe_slot_map;
+  struct RxPipeSlot* rx_pipe_slots;  // Indexed by slot.
+  uint32_t rx_pipe_slot_map_mask;    // Number of entries minus one.
+
   uint32_t rx_head;
-  uint32_t tx_head;
-  uint32_t tx_tail;
   uint16_t next_rx_ids_head;
   uint16_t next_rx_ids_tail;
+
+  // Notification coalescing: when enabled, each pipe is added to
+  // next_rx_pipe_notifs at most once per call to `get_new_tails`.
+  uint32_t notif_gen;
+  bool coalesce_notifs;
+
+  // TX hot section:
+  alignas(64) struct TxNotification* tx_buf;
+  uint32_t* tx_tail_ptr;
+  uint8_t* wrap_tracker;
+  uint32_t tx_head;
+  uint32_t tx_tail;
+
+  // Deferred TX doorbell: `tx_tail` is only written to the NIC once it is
+  // `tx_tail_flush_threshold` notifications ahead of `tx_tail_reported` (or on
+  // an explicit flush). A threshold of 0 writes it on every send.
+  uint32_t tx_tail_reported;
+  uint32_t tx_tail_flush_threshold;
   uint32_t nb_unreported_completions;
-  uint32_t id;
 
-  // Second cache line:
+  // Cold section:
+  alignas(64) uint32_t id;
+  uint32_t ref_cnt;
   struct QueueRegs* regs;
   uint64_t tx_full_cnt;
-  uint32_t ref_cnt;
 
-  uint8_t* wrap_tracker;
-  uint32_t* pending_rx_pipe_tails;
+  uint32_t nb_rx_pipe_slots;  // Slots in use, including freed ones.
+  uint32_t rx_pipe_slots_capacity;
+  std::vector<uint32_t> free_rx_pipe_slots;
 
   void* fpga_dev;            // Avoid exposing `DevBackend` externally.
-  void* uio_mmap_bar2_addr;  // UIO mmap address for BAR 2.
+  void* uio_mmap_bar2_addr;  // UIO mmap address for BAR 2. Only used by
+                             // backends that emulate MMIO.
   std::string huge_page_prefix;
+  struct HugePageArena* pipe_buf_arena;  // Buffers for RX and TX pipes.
 };
 
+static_assert(offsetof(NotificationBufPair, coalesce_notifs) < 64,
+              "RX hot section must fit in a cache line");
+static_assert(offsetof(NotificationBufPair, tx_buf) == 64,
+              "TX hot section must start in the second cache line");
+static_assert(offsetof(NotificationBufPair, nb_unreported_completions) < 128,
+              "TX hot section must fit in a cache line");
+
 struct RxEnsoPipeInternal {
+  // Hot section, used when receiving and freeing data. It is kept to
+  // `kRxEnsoPipeInternalHotSize` bytes so that `RxPipe` can fit it in the same
+  // cache line as its own hot fields.
   uint32_t* buf;
-  uint64_t buf_phys_addr;
-  struct QueueRegs* regs;
   uint32_t* buf_head_ptr;
   uint32_t rx_head;
   uint32_t rx_tail;
+  uint32_t last_reported_head;     // Last head written to `buf_head_ptr`.
+  uint32_t head_update_threshold;  // In flits. 0 reports on every update.
+  uint32_t mask;  // Pipe size (in flits) minus one.
+  uint32_t slot;  // Slot for the per-pipe state in the notification buffer.
+
+  // Cold section:
+  void* uio_mmap_bar2_addr;  // UIO mmap address for BAR 2.
+  uint64_t buf_phys_addr;
   uint64_t phys_buf_offset;  // Use to convert between phys and virt address.
+  struct QueueRegs* regs;
   enso_pipe_id_t id;
-  std::string huge_page_prefix;
-  void* uio_mmap_bar2_addr;  // UIO mmap address for BAR 2.
 };
 
+constexpr size_t kRxEnsoPipeInternalHotSize = 40;
+static_assert(offsetof(RxEnsoPipeInternal, uio_mmap_bar2_addr) ==
+                  kRxEnsoPipeInternalHotSize,
+              "Unexpected size for the RxEnsoPipeInternal hot section");
+
 }  // namespace enso
 
 #endif  // ENSO_SOFTWARE_INCLUDE_ENSO_INTERNALS_H_
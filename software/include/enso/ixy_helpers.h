@@ -40,6 +40,8 @@
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace enso {
 
@@ -51,6 +53,22 @@ namespace enso {
  */
 uint64_t virt_to_phys(void* virt);
 
+/**
+ * Converts multiple virtual addresses to physical addresses.
+ *
+ * Converts `nb_addrs` addresses, starting at `virt` and separated by `stride`
+ * bytes. This is much faster than calling `virt_to_phys` for every address, as
+ * the translations for many addresses are read at once.
+ *
+ * @param virt The first virtual address to convert.
+ * @param stride Distance in bytes between the addresses to convert.
+ * @param nb_addrs Number of addresses to convert.
+ * @param phys Array where the `nb_addrs` physical addresses will be stored.
+ * @return 0 on success, -1 if any of the addresses cannot be converted.
+ */
+int virt_to_phys_batch(void* virt, size_t stride, uint32_t nb_addrs,
+                       uint64_t* phys);
+
 /**
  * Allocates a huge page and returns a pointer to it.
  *
@@ -68,6 +86,83 @@ uint64_t virt_to_phys(void* virt);
 void* get_huge_page(const std::string& path, size_t size = 0,
                     bool mirror = false);
 
+/**
+ * Allocates a pinned buffer backed by regular pages and mirrors it, i.e., the
+ * same memory is mapped again right after the buffer.
+ *
+ * The virtual addresses of the buffer and its mirror never cross a huge page
+ * boundary, but the memory is only guaranteed to be physically contiguous if
+ * `size` is at most the regular page size. Buffers larger than that can only
+ * be shared with devices that use virtual addresses.
+ *
+ * @param size Size of the buffer in bytes. Must be a power of two, at least
+ *             as large as the regular page size, and smaller than
+ *             `kBufPageSize`.
+ * @return A pointer to the buffer, or nullptr on failure. Must be freed with
+ *         `free_mirrored_buf`.
+ */
+void* get_mirrored_buf(size_t size);
+
+/**
+ * Frees a buffer allocated with `get_mirrored_buf` or with `get_huge_page`
+ * with `mirror` set.
+ *
+ * @param buf The buffer to free.
+ * @param size Size of the buffer in bytes, not including the mirror.
+ */
+void free_mirrored_buf(void* buf, size_t size);
+
+/**
+ * Huge page file from which mirrored buffers of `kBufPageSize` bytes are
+ * allocated.
+ *
+ * Every buffer is a slot in the same file and is mapped twice in sequence, like
+ * the ones returned by `get_huge_page` with `mirror` set. Sharing the file
+ * avoids creating, truncating and removing a file for every buffer.
+ */
+struct HugePageArena {
+  std::string path;
+  int fd;
+  uint32_t nb_slots;  // Number of slots that the file currently holds.
+  std::vector<uint32_t> free_slots;
+  std::unordered_map<void*, uint32_t> slots;  // Slot for every buffer in use.
+};
+
+/**
+ * Initializes a huge page arena.
+ *
+ * @param arena The arena to initialize.
+ * @param path Path to the huge page file that backs the arena.
+ * @return 0 on success, -1 on failure.
+ */
+int huge_page_arena_init(struct HugePageArena* arena, const std::string& path);
+
+/**
+ * Allocates a mirrored buffer of `kBufPageSize` bytes from the arena.
+ *
+ * @param arena The arena to allocate from.
+ * @return A pointer to the buffer, or nullptr on failure.
+ */
+void* huge_page_arena_alloc(struct HugePageArena* arena);
+
+/**
+ * Returns a buffer allocated with `huge_page_arena_alloc` to the arena.
+ *
+ * The huge page stays allocated and is reused by the next allocation. Huge
+ * pages are only given back to the system by `huge_page_arena_destroy`.
+ *
+ * @param arena The arena that the buffer was allocated from.
+ * @param buf The buffer to free.
+ */
+void huge_page_arena_free(struct HugePageArena* arena, void* buf);
+
+/**
+ * Releases the arena. All buffers must have been freed.
+ *
+ * @param arena The arena to release.
+ */
+void huge_page_arena_destroy(struct HugePageArena* arena);
+
 }  // namespace enso
 
 #endif  // ENSO_SOFTWARE_INCLUDE_ENSO_IXY_HELPERS_H_
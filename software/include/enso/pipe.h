@@ -43,9 +43,12 @@
 #define ENSO_SOFTWARE_INCLUDE_ENSO_PIPE_H_
 
 #include <enso/consts.h>
+#include <enso/fast_path.h>
 #include <enso/helpers.h>
 #include <enso/internals.h>
+#include <enso/wait.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <chrono>
@@ -57,9 +60,11 @@
 
 namespace enso {
 
+class Device;
 class RxPipe;
 class TxPipe;
 class RxTxPipe;
+class PipeGroup;
 
 class PktIterator;
 class PeekPktIterator;
@@ -68,6 +73,147 @@ uint32_t external_peek_next_batch_from_queue(
     struct RxEnsoPipeInternal* enso_pipe,
     struct NotificationBufPair* notification_buf_pair, void** buf);
 
+/**
+ * @brief A class that represents a batch of messages.
+ *
+ * @param T An iterator for the particular message type. Refer to
+ *          `enso::PktIterator` for an example of a raw packet iterator.
+ */
+template <typename T>
+class MessageBatch {
+ public:
+  /**
+   * @brief Instantiates an empty message batch.
+   */
+  constexpr MessageBatch() : MessageBatch(nullptr, 0, 0, nullptr) {}
+
+  MessageBatch(const MessageBatch&) = default;
+  MessageBatch(MessageBatch&&) = default;
+
+  MessageBatch& operator=(const MessageBatch&) = default;
+  MessageBatch& operator=(MessageBatch&&) = default;
+
+  constexpr T begin() { return T(buf_, message_limit_, this); }
+  constexpr T begin() const { return T(buf_, message_limit_, this); }
+
+  constexpr T end() { return T(buf_ + available_bytes_, message_limit_, this); }
+  constexpr T end() const {
+    return T(buf_ + available_bytes_, message_limit_, this);
+  }
+
+  /**
+   * @brief Number of bytes processed by the iterator.
+   */
+  uint32_t processed_bytes() const { return processed_bytes_; }
+
+  /**
+   * @brief Notifies the batch that a given number of bytes have been
+   *        processed.
+   *
+   * @param nb_bytes The number of bytes processed.
+   */
+  inline void NotifyProcessedBytes(uint32_t nb_bytes) {
+    processed_bytes_ += nb_bytes;
+  }
+
+  /**
+   * @brief Returns number of bytes available in the batch.
+   *
+   * @note It may include more messages than `message_limit()`, in which case,
+   * iterating over the batch will result in fewer bytes than
+   * `available_bytes()`. After iterating over the batch, the total number of
+   * bytes iterated over can be obtained by calling `processed_bytes()`.
+   *
+   * @return The number of bytes available in the batch.
+   */
+  uint32_t available_bytes() const { return available_bytes_; }
+
+  /**
+   * @brief Returns maximum number of messages in the batch.
+   *
+   * @return The maximum number of messages in the batch.
+   */
+  int32_t message_limit() const { return message_limit_; }
+
+  /**
+   * @brief Returns a pointer to the start of the batch.
+   *
+   * @return A pointer to the start of the batch.
+   */
+  uint8_t* buf() const { return buf_; }
+
+ private:
+  /**
+   * Can only be constructed by RxPipe.
+   *
+   * @param buf A pointer to the start of the batch.
+   * @param available_bytes The number of bytes available in the batch.
+   * @param message_limit The maximum number of messages in the batch.
+   * @param pipe The pipe that created this batch.
+   */
+  constexpr MessageBatch(uint8_t* buf, uint32_t available_bytes,
+                         int32_t message_limit, RxPipe* pipe)
+      : available_bytes_(available_bytes),
+        message_limit_(message_limit),
+        buf_(buf),
+        pipe_(pipe) {}
+
+  friend class RxPipe;
+  friend T;
+
+  uint32_t available_bytes_;
+  int32_t message_limit_;
+  uint8_t* buf_;
+  uint32_t processed_bytes_ = 0;
+  RxPipe* pipe_;
+};
+
+/**
+ * @brief Memory registered with a Device using `Device::RegisterMemory()`.
+ *
+ * Keeps the address that the device uses for every huge page in the region, so
+ * that addresses in the region can be converted without a system call.
+ */
+class MemoryRegion {
+ public:
+  MemoryRegion(const MemoryRegion&) = delete;
+  MemoryRegion& operator=(const MemoryRegion&) = delete;
+  MemoryRegion(MemoryRegion&&) = delete;
+  MemoryRegion& operator=(MemoryRegion&&) = delete;
+
+  /**
+   * @brief Converts an address in the region to an address that can be used by
+   *        the device, e.g., to send it with `Device::Send()`.
+   *
+   * @param addr Address in the region.
+   * @return Address that can be used by the device.
+   */
+  inline uint64_t GetDevAddr(const void* addr) const {
+    uint64_t offset = (const uint8_t*)addr - base_;
+    return page_dev_addrs_[offset / kBufPageSize] + offset % kBufPageSize;
+  }
+
+  /**
+   * @brief Returns whether `addr` is in the region.
+   */
+  inline bool Contains(const void* addr) const {
+    return (const uint8_t*)addr >= base_ && (const uint8_t*)addr < end_;
+  }
+
+ private:
+  /**
+   * MemoryRegions can only be instantiated from a `Device` object, using the
+   * `RegisterMemory()` method.
+   */
+  MemoryRegion(uint8_t* base, uint8_t* end) noexcept : base_(base), end_(end) {}
+
+  friend class Device;
+
+  uint8_t* base_;  ///< Start of the first huge page in the region.
+  uint8_t* end_;   ///< End of the region.
+  std::vector<uint64_t> page_dev_addrs_;
+};
+
 /**
  * @brief A class that represents a device.
  *
@@ -136,6 +282,11 @@ class Device {
    * @param fallback Whether this pipe is a fallback pipe. Fallback pipes can
    *                 receive data from any flow but are also guaranteed to
    *                 receive data from all flows that they `Bind()` to.
+   * @param buf_size Size of the pipe's buffer in bytes. Must be a power of two
+   *                 between `kMinEnsoPipeSize * 64` and
+   *                 `kMaxEnsoPipeSize * 64`. Pipes of a size other than the
+   *                 default (`kEnsoPipeSize * 64`) are not taken from the pipe
+   *                 pool and may not be supported by the device.
    *
    * @note The hardware can only use a number of fallback pipes that is a power
    *       of two. If the number of fallback pipes is not a power of two, only
@@ -147,7 +298,34 @@ class Device {
    *
    * @return A pointer to the pipe. May be null if the pipe cannot be created.
    */
-  RxPipe* AllocateRxPipe(bool fallback = false) noexcept;
+  RxPipe* AllocateRxPipe(bool fallback = false,
+                         uint32_t buf_size = kEnsoPipeSize * 64) noexcept;
+
+  /**
+   * @brief Sets up RX pipes in advance, so that they can be quickly handed out
+   *        by `AllocateRxPipe()` and `AllocateRxTxPipe()`.
+   *
+   * Setting up a pipe requires mapping its buffer, waiting for the device
+   * registers and updating the device configuration. Doing this for many
+   * pipes at once amortizes most of this cost. Non-fallback allocations then
+   * take a pipe from the pool, if there is one available, instead of setting
+   * up a new one.
+   *
+   * @note Pipes in the pool count towards the device pipe limit. They are
+   *       freed when the Device is destroyed.
+   *
+   * @param nb_pipes Number of pipes to add to the pool.
+   *
+   * @return 0 on success, -1 on failure. On failure, no pipes are added.
+   */
+  int FillPipePool(uint32_t nb_pipes) noexcept;
+
+  /**
+   * @brief Gets the number of pipes currently in the pipe pool.
+   *
+   * @see FillPipePool
+   */
+  uint32_t GetPipePoolSize() const noexcept { return rx_pipe_pool_.size(); }
 
   /**
    * @brief Allocates a TX pipe.
@@ -155,10 +333,49 @@ class Device {
    * @param buf Buffer address to use for the pipe. It must be a pinned
    *            hugepage. If not specified, the buffer is allocated
    *            internally.
+   * @param buf_size Size of `buf` in bytes. Must be a power of two between
+   *                 `TxPipe::kQuantumSize` and `kBufPageSize` and the buffer
+   *                 must be mirrored, like the buffers used by RX pipes.
+   *                 Ignored if `buf` is not specified.
    * @return A pointer to the pipe. May be null if the pipe cannot be
    *         created.
    */
-  TxPipe* AllocateTxPipe(uint8_t* buf = nullptr) noexcept;
+  TxPipe* AllocateTxPipe(uint8_t* buf = nullptr,
+                         uint32_t buf_size = kEnsoPipeSize * 64) noexcept;
+
+  /**
+   * @brief Registers memory that the application will send with the device.
+   *
+   * Converting an address to one that the device can use typically requires a
+   * system call. Registering the memory translates all of it at once, so that
+   * individual addresses can later be converted with
+   * `MemoryRegion::GetDevAddr()`.
+   *
+   * @param addr Start of the memory to register. The memory must be backed by
+   *             pinned huge pages of `kBufPageSize` bytes.
+   * @param size Size of the memory in bytes.
+   *
+   * @return The registered region, owned by the Device. May be null if the
+   *         memory cannot be registered.
+   */
+  const MemoryRegion* RegisterMemory(void* addr, size_t size) noexcept;
+
+  /**
+   * @brief Deregisters memory registered with `RegisterMemory()`.
+   *
+   * @param region Region returned by `RegisterMemory()`. Must not be used
+   *               after this call.
+   */
+  void DeregisterMemory(const MemoryRegion* region) noexcept;
+
+  /**
+   * @brief Allocates an empty group of pipes that can be polled together with
+   *        `PipeGroup::PollAll()`.
+   *
+   * @return A pointer to the group, owned by the Device. May be null if the
+   *         group cannot be allocated.
+   */
+  PipeGroup* AllocatePipeGroup() noexcept;
 
   /**
    * @brief Retrieves the number of fallback queues for this device.
@@ -171,6 +388,8 @@ class Device {
    * @param fallback Whether this pipe is a fallback pipe. Fallback pipes can
    *                 receive data from any flow but are also guaranteed to
    *                 receive data from all flows that they `Bind()` to.
+   * @param buf_size Size of the pipe's buffer in bytes. Same as in
+   *                 `AllocateRxPipe()` but must be at most `kBufPageSize`.
    *
    * @note The hardware can only use a number of fallback pipes that is a power
    *       of two. If the number of fallback pipes is not a power of two, only
@@ -182,7 +401,8 @@ class Device {
    *
    * @return A pointer to the pipe. May be null if the pipe cannot be created.
    */
-  RxTxPipe* AllocateRxTxPipe(bool fallback = false) noexcept;
+  RxTxPipe* AllocateRxTxPipe(bool fallback = false,
+                             uint32_t buf_size = kEnsoPipeSize * 64) noexcept;
 
   /**
    * @brief Gets the next RX notification received by this device.
@@ -211,11 +431,101 @@ class Device {
    */
   RxTxPipe* NextRxTxPipeToRecv();
 
+  /**
+   * @brief Waits for the NIC to post a new RX notification to this device.
+   *
+   * Should be called when `NextRxPipeToRecv()`, `NextRxTxPipeToRecv()` or
+   * `RecvBurst()` return no pipes, instead of polling again right away. Every
+   * call waits for a bit longer, following the waiter's strategy, until the
+   * waiter is reset.
+   *
+   * @param waiter Waiter to use. Should be reset after receiving data.
+   */
+  void WaitForRx(Waiter* waiter);
+
+  /**
+   * @brief Receives messages from all the RxPipes that have data pending.
+   *
+   * Consumes up to `kBatchSize` notifications at once and returns every pipe
+   * that is ready along with its batch. Each pipe appears at most once per
+   * call, with all the data it has available. This amortizes notification
+   * handling over the whole burst, instead of paying for it on every pipe, as
+   * with `NextRxPipeToRecv()`.
+   *
+   * Example:
+   * @code
+   *    std::array<RxPipe*, kBatchSize> pipes;
+   *    std::array<MessageBatch<PktIterator>, kBatchSize> batches;
+   *    uint32_t nb_pipes =
+   *        device->RecvBurst(pipes.data(), batches.data(), kBatchSize);
+   *    for (uint32_t i = 0; i < nb_pipes; ++i) {
+   *      for (auto pkt : batches[i]) {
+   *        // Do something with the packet.
+   *      }
+   *      pipes[i]->Clear();
+   *    }
+   * @endcode
+   *
+   * @warning This function can only be used when there are *only* RX pipes.
+   * Trying to use this function when there are RX/TX pipes will result in
+   * undefined behavior.
+   *
+   * @param T An iterator for the particular message type. Refer to
+   *          `enso::PktIterator` for an example of a raw packet iterator.
+   * @param pipes Array where the pipes with data pending will be stored.
+   * @param batches Array where the batch for each pipe will be stored.
+   * @param max_nb_pipes Maximum number of pipes to return, must not be larger
+   *                     than the size of `pipes` and `batches`.
+   *
+   * @return The number of pipes stored in `pipes`. May be 0 if no pipe has
+   *         data pending.
+   */
+  template <typename T>
+  uint32_t RecvBurst(RxPipe** pipes, MessageBatch<T>* batches,
+                     uint32_t max_nb_pipes);
+
+  /**
+   * @brief Receives messages from all the RxTxPipes that have data pending.
+   *
+   * Same as the RxPipe variant but for RxTxPipes. Completions are processed
+   * only once for the whole burst.
+   *
+   * @warning This function can only be used when there are *only* RX/TX pipes.
+   * Trying to use this function when there are RX pipes allocated will result
+   * in undefined behavior.
+   *
+   * @see RecvBurst(RxPipe**, MessageBatch<T>*, uint32_t)
+   */
+  template <typename T>
+  uint32_t RecvBurst(RxTxPipe** pipes, MessageBatch<T>* batches,
+                     uint32_t max_nb_pipes);
+
   /**
    * @brief Processes completions for all pipes associated with this device.
+   *
+   * Only RxTxPipes that received completions in this call have their RX space
+   * freed.
    */
   void ProcessCompletions();
 
+  /**
+   * @brief Sets how often the receive functions of RxTxPipes process
+   *        completions.
+   *
+   * `RxTxPipe::Recv()`, `RxTxPipe::RecvPkts()`, `NextRxTxPipeToRecv()`,
+   * `RecvBurst()` and the like process completions so that space freed by
+   * transmissions can be used to receive more data. With an interval of
+   * `nb_calls`, completions are only processed once every `nb_calls` calls to
+   * these functions. The default is 1, processing completions on every call.
+   * Explicit calls to `ProcessCompletions()` are not affected.
+   *
+   * @param nb_calls Number of receive calls between processing completions.
+   *                 Must be greater than 0.
+   *
+   * @return 0 on success, -1 on failure.
+   */
+  int SetCompletionsReapInterval(uint32_t nb_calls);
+
   /**
    * @brief Enables hardware time stamping.
    *
@@ -364,6 +674,97 @@ class Device {
    */
   int GetRoundRobinStatus() noexcept;
 
+  /**
+   * @brief Enables notification coalescing.
+   *
+   * By default, a pipe that receives multiple notifications in the same batch
+   * is returned multiple times by `NextRxPipeToRecv()` (and the other
+   * `Next*PipeToRecv()` functions), and later visits often find little or no
+   * new data. With coalescing, each pipe is returned at most once per batch of
+   * notifications and is visited with all the data that is available for it.
+   *
+   * The notification returned by `NextRxNotif()` for a coalesced pipe is the
+   * first one it received in the batch, so its `tail` may be stale. Receive
+   * from the pipe rather than relying on the notification's tail.
+   *
+   * @note Unlike the other settings, this only affects this Device.
+   *
+   * @see DisableNotificationCoalescing
+   */
+  void EnableNotificationCoalescing() noexcept;
+
+  /**
+   * @brief Disables notification coalescing.
+   *
+   * @see EnableNotificationCoalescing
+   */
+  void DisableNotificationCoalescing() noexcept;
+
+  /**
+   * @brief Defers TX doorbells so that sends from multiple pipes can be
+   *        reported to the NIC with a single MMIO write.
+   *
+   * By default, every send (e.g., `TxPipe::SendAndFree`) writes the new tail of
+   * the TX notification buffer to the NIC. When the doorbell is deferred, sends
+   * only enqueue their notifications and the tail is written once
+   * `nb_notifications` notifications are pending, or when `FlushTx()` is
+   * called. Applications should call `FlushTx()` after every batch of sends,
+   * otherwise the last sends may be delayed indefinitely.
+   *
+   * @param nb_notifications Number of pending notifications that
+   *                         automatically trigger a flush. Must be at most
+   *                         `kMaxTxFlushThreshold`.
+   *
+   * @see DisableDeferredTxDoorbell
+   * @see FlushTx
+   *
+   * @return 0 on success, -1 on failure.
+   */
+  int EnableDeferredTxDoorbell(uint32_t nb_notifications = kBatchSize);
+
+  /**
+   * @brief Writes the TX doorbell on every send again, flushing any pending
+   *        notifications.
+   *
+   * @see EnableDeferredTxDoorbell
+   */
+  void DisableDeferredTxDoorbell();
+
+  /**
+   * @brief Reports all pending TX notifications to the NIC.
+   *
+   * @see EnableDeferredTxDoorbell
+   */
+  void FlushTx();
+
+  /**
+   * @brief Transmits bytes received on an RxPipe without copying them to a
+   *        TxPipe. The bytes are freed from the RxPipe once the NIC reports
+   *        that they were sent.
+   *
+   * This generalizes what RxTxPipe does for a single pipe: the bytes can be
+   * forwarded from any RxPipe allocated by this Device and may be modified in
+   * place before being forwarded. Like with `RxPipe::FreeRange()`, the bytes
+   * must not be freed by the application with `RxPipe::Free()` or
+   * `RxPipe::Clear()`, otherwise the NIC may overwrite them before they are
+   * sent. The remaining bytes in the pipe should be released with
+   * `RxPipe::FreeRange()` or also be forwarded.
+   *
+   * Pipes larger than `kBufPageSize` are made of huge pages that are not
+   * physically contiguous, so bytes cannot be forwarded from them.
+   *
+   * @param rx_pipe The RxPipe that received the bytes. Its buffer must be at
+   *                most `kBufPageSize` bytes.
+   * @param start Pointer to the first byte to forward. Must point to the start
+   *              of a flit (64 bytes) owned by the application.
+   * @param nb_bytes Number of bytes to forward. Must be a multiple of 64.
+   *
+   * @return 0 on success, -1 if the pipe's buffer is too large. In the latter
+   *         case, nothing is sent and the bytes are not freed.
+   */
+  int ForwardAndFree(RxPipe* rx_pipe, const uint8_t* start,
+                     uint32_t nb_bytes);
+
   /**
    * @brief Sends the given config notification to the device.
    *
@@ -380,9 +781,51 @@ class Device {
    * @param phys_addr The physical address of the buffer region to send.
    * @param nb_bytes The number of bytes to send.
    * @return The number of bytes sent.
+   *
+   * @tparam Park Policy called while waiting for free TX notifications. The
+   *         default calls the park callback set with `InitializeBackend()`,
+   *         `fast_path::SpinPark` busy waits instead.
    */
-  void Send(int tx_enso_pipe_id, uint64_t phys_addr, uint32_t nb_bytes,
-            uint64_t sent_time = 0);
+  template <typename Park = fast_path::CallbackPark>
+  inline void Send(int tx_enso_pipe_id, uint64_t phys_addr, uint32_t nb_bytes,
+                   uint64_t sent_time = 0) {
+    // Empty requests produce no notification and would thus never complete.
+    if (unlikely(nb_bytes == 0)) {
+      return;
+    }
+
+    // TODO(sadok): We might be able to improve performance by avoiding the
+    // wrap tracker currently used inside send_to_queue.
+    fast_path::send_to_queue<fast_path::FastPathMmio, Park>(
+        &notification_buf_pair_, phys_addr, nb_bytes, sent_time);
+
+    // This will block until there is enough space to keep at least two
+    // requests. We need space for two requests because the request may be
+    // split into two if the bytes wrap around the end of the buffer.
+    uint32_t nb_pending_requests =
+        (tx_pr_tail_ - tx_pr_head_) & kPendingTxRequestsBufMask;
+    if (unlikely(nb_pending_requests >= (kMaxPendingTxRequests - 2))) {
+      WaitForPendingTxRequests();
+    }
+
+    tx_pending_requests_[tx_pr_tail_].phys_addr = phys_addr;
+    tx_pending_requests_[tx_pr_tail_].pipe_id = tx_enso_pipe_id;
+    tx_pending_requests_[tx_pr_tail_].nb_bytes = nb_bytes;
+    tx_pr_tail_ = (tx_pr_tail_ + 1) & kPendingTxRequestsBufMask;
+  }
+
+  /**
+   * @brief Same as `Send()` but never blocks. This is designed to be used by a
+   * TxPipe object.
+   *
+   * @param tx_enso_pipe_id The ID of the TxPipe.
+   * @param phys_addr The physical address of the buffer region to send.
+   * @param nb_bytes The number of bytes to send.
+   * @return true if the bytes were sent, false if sending them would block. In
+   *         the latter case, nothing is sent.
+   */
+  bool TrySend(int tx_enso_pipe_id, uint64_t phys_addr, uint32_t nb_bytes,
+               uint64_t sent_time = 0);
 
   /**
    * @brief Gets the ID of the notification buffer for this device.
@@ -424,6 +867,12 @@ class Device {
     uint64_t phys_addr;
   };
 
+  // Set in `TxPendingRequest::pipe_id` for requests from `ForwardAndFree()`.
+  // The remaining bits hold the ID of the RxPipe to free.
+  static constexpr int kForwardedRequestFlag = 1 << 30;
+  static_assert(kMaxNbFlows <= kForwardedRequestFlag,
+                "Pipe IDs must not overlap with kForwardedRequestFlag");
+
   /**
    * Use `Create` factory method to instantiate objects externally.
    */
@@ -451,13 +900,63 @@ class Device {
    */
   int Init(int32_t uthread_id) noexcept;
 
+  /**
+   * @brief Gets all the RxPipes with data pending, consuming up to `kBatchSize`
+   *        notifications. Each pipe is returned at most once.
+   *
+   * @param pipes Array where the pipes will be stored.
+   * @param max_nb_pipes Maximum number of pipes to return.
+   * @param update_packet Function to call for every notification. Resolved at
+   *                      compile time, a `std::function` is only called if it
+   *                      is set.
+   *
+   * @return The number of pipes stored in `pipes`.
+   */
+  template <typename UpdateFn = fast_path::NoUpdatePacket>
+  uint32_t NextRxPipesToRecv(RxPipe** pipes, uint32_t max_nb_pipes,
+                             const UpdateFn& update_packet = UpdateFn());
+
+  /**
+   * @brief Gets the RxPipe with the given hardware ID.
+   *
+   * @return A pointer to the pipe or nullptr if no RxPipe in this device has
+   *         this ID.
+   */
+  RxPipe* GetRxPipe(enso_pipe_id_t id) const noexcept;
+
+  /**
+   * @brief Gets the RxTxPipe with the given hardware RX ID.
+   *
+   * @return A pointer to the pipe or nullptr if no RxTxPipe in this device has
+   *         this ID.
+   */
+  RxTxPipe* GetRxTxPipe(enso_pipe_id_t id) const noexcept;
+
+  /**
+   * @brief Processes completions if `SetCompletionsReapInterval()` calls to
+   *        this function have happened since the last time.
+   */
+  inline void MaybeProcessCompletions() {
+    if (--calls_to_next_reap_ == 0) {
+      calls_to_next_reap_ = completions_reap_interval_;
+      ProcessCompletions();
+    }
+  }
+
+  /**
+   * @brief Blocks until the number of pending TX requests is low enough for
+   *        `Send()` to add another one.
+   */
+  void WaitForPendingTxRequests();
+
   friend class RxPipe;
   friend class TxPipe;
   friend class RxTxPipe;
+  friend class PipeGroup;
 
   const std::string kPcieAddr;
 
-  struct NotificationBufPair notification_buf_pair_;
+  struct NotificationBufPair notification_buf_pair_ = {};
   int16_t core_id_;
   uint16_t bdf_;
   std::string huge_page_prefix_;
@@ -467,11 +966,28 @@ class Device {
   std::vector<RxPipe*> rx_pipes_;
   std::vector<TxPipe*> tx_pipes_;
   std::vector<RxTxPipe*> rx_tx_pipes_;
-
-  std::array<RxPipe*, kMaxNbFlows> rx_pipes_map_ = {};
-  std::array<RxTxPipe*, kMaxNbFlows> rx_tx_pipes_map_ = {};
+  std::vector<RxPipe*> rx_pipe_pool_;  ///< Pipes set up by `FillPipePool()`.
+  std::vector<MemoryRegion*> memory_regions_;
+  std::vector<PipeGroup*> pipe_groups_;
+
+  // Indexed by the pipe's slot in the notification buffer rather than by its
+  // ID, so that they only grow with the number of pipes in this device.
+  std::vector<RxPipe*> rx_pipes_by_slot_;
+  std::vector<RxTxPipe*> rx_tx_pipes_by_slot_;
+
+  // RxTxPipe that owns each TxPipe, indexed by TxPipe ID. nullptr for TxPipes
+  // allocated directly by the application.
+  std::vector<RxTxPipe*> rx_tx_pipes_by_tx_id_;
+
+  // RxTxPipes that received completions since they were last processed. Has
+  // capacity for every RxTxPipe so that `ProcessCompletions()` never
+  // allocates.
+  std::vector<RxTxPipe*> completed_rx_tx_pipes_;
+  uint32_t completions_reap_interval_ = 1;
+  uint32_t calls_to_next_reap_ = 1;
 
   int32_t next_pipe_id_ = -1;
+  uint32_t burst_id_ = 0;  ///< Incremented for every call to `RecvBurst()`.
 
   uint32_t tx_pr_head_ = 0;
   uint32_t tx_pr_tail_ = 0;
@@ -503,101 +1019,10 @@ class Device {
 class RxPipe {
  public:
   /**
-   * @brief A class that represents a batch of messages.
-   *
-   * @param T An iterator for the particular message type. Refer to
-   *          `enso::PktIterator` for an example of a raw packet iterator.
+   * @copydoc enso::MessageBatch
    */
   template <typename T>
-  class MessageBatch {
-   public:
-    /**
-     * @brief Instantiates an empty message batch.
-     */
-    constexpr MessageBatch() : MessageBatch(nullptr, 0, 0, nullptr) {}
-
-    MessageBatch(const MessageBatch&) = default;
-    MessageBatch(MessageBatch&&) = default;
-
-    MessageBatch& operator=(const MessageBatch&) = default;
-    MessageBatch& operator=(MessageBatch&&) = default;
-
-    constexpr T begin() { return T(buf_, message_limit_, this); }
-    constexpr T begin() const { return T(buf_, message_limit_, this); }
-
-    constexpr T end() {
-      return T(buf_ + available_bytes_, message_limit_, this);
-    }
-    constexpr T end() const {
-      return T(buf_ + available_bytes_, message_limit_, this);
-    }
-
-    /**
-     * @brief Number of bytes processed by the iterator.
-     */
-    uint32_t processed_bytes() const { return processed_bytes_; }
-
-    /**
-     * @brief Notifies the batch that a given number of bytes have been
-     *        processed.
-     *
-     * @param nb_bytes The number of bytes processed.
-     */
-    inline void NotifyProcessedBytes(uint32_t nb_bytes) {
-      processed_bytes_ += nb_bytes;
-    }
-
-    /**
-     * @brief Returns number of bytes available in the batch.
-     *
-     * @note It may include more messages than `message_limit()`, in which case,
-     * iterating over the batch will result in fewer bytes than
-     * `available_bytes()`. After iterating over the batch, the total number of
-     * bytes iterated over can be obtained by calling `processed_bytes()`.
-     *
-     * @return The number of bytes available in the batch.
-     */
-    uint32_t available_bytes() const { return available_bytes_; }
-
-    /**
-     * @brief Returns maximum number of messages in the batch.
-     *
-     * @return The maximum number of messages in the batch.
-     */
-    int32_t message_limit() const { return message_limit_; }
-
-    /**
-     * @brief Returns a pointer to the start of the batch.
-     *
-     * @return A pointer to the start of the batch.
-     */
-    uint8_t* buf() const { return buf_; }
-
-   private:
-    /**
-     * Can only be constructed by RxPipe.
-     *
-     * @param buf A pointer to the start of the batch.
-     * @param available_bytes The number of bytes available in the batch.
-     * @param message_limit The maximum number of messages in the batch.
-     * @param pipe The pipe that created this batch.
-     */
-    constexpr MessageBatch(uint8_t* buf, uint32_t available_bytes,
-                           int32_t message_limit, RxPipe* pipe)
-        : available_bytes_(available_bytes),
-          message_limit_(message_limit),
-          buf_(buf),
-          pipe_(pipe) {}
-
-    friend class RxPipe;
-    friend T;
-
-    uint32_t available_bytes_;
-    int32_t message_limit_;
-    uint8_t* buf_;
-    uint32_t processed_bytes_ = 0;
-    RxPipe* pipe_;
-  };
+  using MessageBatch = enso::MessageBatch<T>;
 
   RxPipe(const RxPipe&) = delete;
   RxPipe& operator=(const RxPipe&) = delete;
@@ -667,7 +1092,11 @@ class RxPipe {
    *
    * @return The number of bytes received.
    */
-  uint32_t Recv(uint8_t** buf, uint32_t max_nb_bytes);
+  inline uint32_t Recv(uint8_t** buf, uint32_t max_nb_bytes) {
+    uint32_t ret = Peek(buf, max_nb_bytes);
+    ConfirmBytes(ret);
+    return ret;
+  }
 
   /**
    * @brief Receives a batch of bytes without removing them from the queue.
@@ -677,7 +1106,14 @@ class RxPipe {
    *
    * @return The number of bytes received.
    */
-  uint32_t Peek(uint8_t** buf, uint32_t max_nb_bytes);
+  inline uint32_t Peek(uint8_t** buf, uint32_t max_nb_bytes) {
+    if (!next_pipe_) {
+      fast_path::get_new_tails<fast_path::FastPathMmio>(notification_buf_pair_);
+    }
+    uint32_t ret = fast_path::consume_queue(
+        &internal_rx_pipe_, notification_buf_pair_, (void**)buf, true);
+    return std::min(ret, max_nb_bytes);
+  }
 
   /**
    * @brief Confirms a certain number of bytes have been received.
@@ -693,7 +1129,7 @@ class RxPipe {
    */
   constexpr void ConfirmBytes(uint32_t nb_bytes) {
     uint32_t rx_tail = internal_rx_pipe_.rx_tail;
-    rx_tail = (rx_tail + nb_bytes / 64) % kEnsoPipeSize;
+    rx_tail = (rx_tail + nb_bytes / 64) & internal_rx_pipe_.mask;
     internal_rx_pipe_.rx_tail = rx_tail;
   }
 
@@ -706,9 +1142,27 @@ class RxPipe {
   constexpr uint32_t capacity() const {
     uint32_t rx_head = internal_rx_pipe_.rx_head;
     uint32_t rx_tail = internal_rx_pipe_.rx_tail;
-    return ((rx_head - rx_tail) % kEnsoPipeSize) * 64;
+    return ((rx_head - rx_tail) & internal_rx_pipe_.mask) * 64;
+  }
+
+  /**
+   * @brief Returns the size of the pipe's buffer, as chosen when allocating
+   *        the pipe.
+   *
+   * @return The size of the pipe's buffer in bytes.
+   */
+  constexpr uint32_t buf_size() const {
+    return (internal_rx_pipe_.mask + 1) * 64;
   }
 
+  /**
+   * @brief Returns the maximum capacity achievable by this pipe. There should
+   *        always be at least one buffer quantum available.
+   *
+   * @return The maximum capacity in bytes.
+   */
+  constexpr uint32_t max_capacity() const { return buf_size() - kQuantumSize; }
+
   /**
    * @brief Receives a batch of generic messages.
    *
@@ -772,14 +1226,76 @@ class RxPipe {
    *
    * @param nb_bytes The number of bytes to free.
    */
-  void Free(uint32_t nb_bytes);
+  inline void Free(uint32_t nb_bytes) {
+    uint32_t rx_head = internal_rx_pipe_.rx_head;
+    fast_path::advance_pipe<fast_path::FastPathMmio>(&internal_rx_pipe_,
+                                                     nb_bytes);
+    if (unlikely(freed_flits_ != nullptr)) {
+      ForgetFreedFlits(rx_head);
+    }
+  }
 
   /**
    * @brief Frees all bytes previously received on the RxPipe.
    *
    * @see Free()
    */
-  void Clear();
+  inline void Clear() {
+    uint32_t rx_head = internal_rx_pipe_.rx_head;
+    fast_path::fully_advance_pipe<fast_path::FastPathMmio>(&internal_rx_pipe_);
+    if (unlikely(freed_flits_ != nullptr)) {
+      ForgetFreedFlits(rx_head);
+    }
+  }
+
+  /**
+   * @brief Frees an arbitrary range of bytes previously received on the
+   *        RxPipe, in any order.
+   *
+   * Different from `Free()`, which always frees the oldest received bytes, this
+   * lets the application release messages out of order, e.g., when a batch is
+   * processed by multiple workers or in a pipeline. The pipe keeps track of
+   * the freed 64-byte flits and only gives space back to the NIC once all the
+   * bytes before them are also freed. All the space that becomes contiguous in
+   * a single call is given back with a single head update.
+   *
+   * Ranges freed with this function must not be freed again with `Free()`.
+   * Like the other functions, this is not thread safe: workers should hand the
+   * ranges back to the thread that owns the pipe.
+   *
+   * @param start Pointer to the first byte to free. Must point to the start of
+   *              a flit (64 bytes) owned by the application.
+   * @param nb_bytes Number of bytes to free. Rounded up to a multiple of 64.
+   *
+   * @return 0 on success, -1 if the range is not owned by the application or
+   *         if there is not enough memory to track it.
+   */
+  int FreeRange(const uint8_t* start, uint32_t nb_bytes);
+
+  /**
+   * @brief Sets how many bytes `Free` and `Clear` may accumulate before
+   *        telling the NIC about the freed space.
+   *
+   * Every update to the pipe's head is an MMIO write, which is expensive when
+   * the application frees small batches at a time. With a threshold, the
+   * freed bytes are only reported once they add up to at least `nb_bytes`,
+   * when the pipe is at least half full from the NIC's perspective, or when
+   * `Flush` is called. By default, the threshold is 0 and every update is
+   * reported.
+   *
+   * @param nb_bytes The threshold in bytes (rounded up to a multiple of 64).
+   *                 Must be at most half of `buf_size()`.
+   *
+   * @return 0 on success, -1 on failure.
+   */
+  int SetHeadUpdateThreshold(uint32_t nb_bytes);
+
+  /**
+   * @brief Tells the NIC about any freed bytes that were not reported yet.
+   *
+   * @see SetHeadUpdateThreshold()
+   */
+  void Flush();
 
   /**
    * @brief Returns the pipe's internal buffer.
@@ -823,8 +1339,10 @@ class RxPipe {
   static constexpr uint32_t kQuantumSize = 64;
 
   /**
-   * Maximum capacity achievable by the pipe. There should always be at least
-   * one buffer quantum available.
+   * Maximum capacity achievable by a pipe of the default size. There should
+   * always be at least one buffer quantum available.
+   *
+   * @see max_capacity()
    */
   static constexpr uint32_t kMaxCapacity = kEnsoPipeSize * 64 - kQuantumSize;
 
@@ -848,22 +1366,46 @@ class RxPipe {
    * @brief Initializes the RX pipe.
    *
    * @param fallback Whether this pipe is a fallback pipe.
+   * @param buf_size Size of the pipe's buffer in bytes.
    *
    * @return 0 on success and a non-zero error code on failure.
    */
-  int Init(bool fallback) noexcept;
+  int Init(bool fallback, uint32_t buf_size) noexcept;
 
   void SetAsNextPipe() noexcept { next_pipe_ = true; }
 
-  friend class Device;
+  /**
+   * @brief Clears the flits released by `FreeRange()` that were since freed by
+   *        `Free()` or `Clear()`, i.e., from `old_rx_head` to the current head.
+   *        Flits released by `FreeRange()` that now start at the head are
+   *        freed as well.
+   */
+  void ForgetFreedFlits(uint32_t old_rx_head);
+
+  /**
+   * @brief Frees the flits released by `FreeRange()` that are contiguous to
+   *        the head, if any.
+   */
+  void FreeReleasedRun();
 
+  friend class Device;
+  friend class PipeGroup;
+
+  // Hot fields, used by `Peek()`, `ConfirmBytes()`, `Free()` and `Clear()`.
+  // Together with the hot section of `internal_rx_pipe_`, they fit in the first
+  // cache line of the pipe.
+  alignas(kCacheLineSize) struct NotificationBufPair* notification_buf_pair_;
+  uint64_t* freed_flits_ = nullptr;  ///< Bitmap of flits released by
+                                     ///< FreeRange(), allocated on first use.
+  uint32_t burst_id_ = 0;            ///< Last burst that returned this pipe.
   bool next_pipe_ = false;  ///< Whether this pipe is the next pipe to be
                             ///< processed by the device. This is used in
                             ///< conjunction with NextRxPipeToRecv().
-  enso_pipe_id_t id_;       ///< The ID of the pipe.
+  struct RxEnsoPipeInternal internal_rx_pipe_ = {};
+
+  // Cold fields.
+  enso_pipe_id_t id_;  ///< The ID of the pipe.
   void* context_;
-  struct RxEnsoPipeInternal internal_rx_pipe_;
-  struct NotificationBufPair* notification_buf_pair_;
 };
 
 /**
@@ -917,9 +1459,9 @@ class TxPipe {
    * address will still not be valid. But allocating a new buffer will return a
    * a buffers that starts with the remaining data.
    *
-   * @warning The capacity will never be go beyond `TxPipe::kMaxCapacity`.
+   * @warning The capacity will never be go beyond `max_capacity()`.
    *          Therefore, specifying a `target_capacity` larger than
-   *          `TxPipe::kMaxCapacity` will cause this function to block forever.
+   *          `max_capacity()` will cause this function to block forever.
    *
    * @param target_capacity Target capacity of the buffer. It will block until
    *                        the buffer is at least this big. May set it to 0 to
@@ -948,19 +1490,102 @@ class TxPipe {
    *
    * @param nb_bytes The number of bytes to send. Must be a multiple of
    *                 `kQuantumSize`.
+   *
+   * @tparam Park Policy called while blocked, see `Device::Send()`.
    */
+  template <typename Park = fast_path::CallbackPark>
   inline void SendAndFree(uint32_t nb_bytes) {
-    uint64_t phys_addr = buf_phys_addr_ + app_begin_;
-    assert(nb_bytes <= kMaxCapacity);
+    assert(nb_bytes <= max_capacity());
+    assert(nb_bytes / kQuantumSize * kQuantumSize == nb_bytes);
+
+    uint64_t sent_time = 0;
+
+    app_begin_ = (app_begin_ + nb_bytes) & buf_mask_;
+
+    // Bytes left behind by `SendAndFreeAsync()` must go first.
+    uint64_t phys_addr = buf_phys_addr_ + hw_end_;
+    uint32_t nb_bytes_to_send = backlog();
+    uint32_t nb_bytes_to_end = buf_mask_ + 1 - hw_end_;
+    hw_end_ = app_begin_;
+
+    // The device only wraps around at huge page boundaries, so requests that
+    // cross the end of a smaller buffer must restart at its beginning.
+    if (unlikely(nb_bytes_to_send > nb_bytes_to_end)) {
+      device_->Send<Park>(kId, phys_addr, nb_bytes_to_end, sent_time);
+      phys_addr = buf_phys_addr_;
+      nb_bytes_to_send -= nb_bytes_to_end;
+    }
+
+    device_->Send<Park>(kId, phys_addr, nb_bytes_to_send, sent_time);
+  }
+
+  /**
+   * @brief Sends and deallocates a given number of bytes, without blocking.
+   *
+   * Behaves like `SendAndFree()`, including the fact that the buffer must be
+   * allocated again afterwards. But, if the device cannot accept the transfer
+   * right away, the bytes are kept in the pipe's backlog instead of blocking.
+   * The backlog is sent, in order, by the next call to `SendAndFree()`,
+   * `SendAndFreeAsync()`, or `TrySendBacklog()`.
+   *
+   * Bytes in the backlog still count towards `pending_transmission()` and are
+   * not part of the `capacity()`.
+   *
+   * @param nb_bytes The number of bytes to send. Must be a multiple of
+   *                 `kQuantumSize`.
+   *
+   * @return The number of bytes that remain in the backlog. If this is
+   *         non-zero, the call would have blocked.
+   */
+  inline uint32_t SendAndFreeAsync(uint32_t nb_bytes) {
+    assert(nb_bytes <= max_capacity());
     assert(nb_bytes / kQuantumSize * kQuantumSize == nb_bytes);
 
+    app_begin_ = (app_begin_ + nb_bytes) & buf_mask_;
+
+    return TrySendBacklog();
+  }
+
+  /**
+   * @brief Tries to send the bytes left in the backlog by
+   *        `SendAndFreeAsync()`, without blocking.
+   *
+   * @return The number of bytes that remain in the backlog.
+   */
+  inline uint32_t TrySendBacklog() {
+    uint32_t nb_bytes = backlog();
+    if (nb_bytes == 0) {
+      return 0;
+    }
+
     uint64_t sent_time = 0;
 
-    app_begin_ = (app_begin_ + nb_bytes) & kBufMask;
+    // Split requests that cross the end of the buffer, as in `SendAndFree()`.
+    uint32_t nb_bytes_to_end = buf_mask_ + 1 - hw_end_;
+    if (unlikely(nb_bytes > nb_bytes_to_end)) {
+      if (!device_->TrySend(kId, buf_phys_addr_ + hw_end_, nb_bytes_to_end,
+                            sent_time)) {
+        return nb_bytes;
+      }
+      hw_end_ = 0;
+      nb_bytes -= nb_bytes_to_end;
+    }
 
-    device_->Send(kId, phys_addr, nb_bytes, sent_time);
+    if (device_->TrySend(kId, buf_phys_addr_ + hw_end_, nb_bytes, sent_time)) {
+      hw_end_ = app_begin_;
+      return 0;
+    }
+    return nb_bytes;
   }
 
+  /**
+   * @brief Returns the number of bytes that were freed with
+   *        `SendAndFreeAsync()` but not yet handed to the device.
+   *
+   * @return Number of bytes in the backlog.
+   */
+  inline uint32_t backlog() const { return (app_begin_ - hw_end_) & buf_mask_; }
+
   /**
    * @brief Explicitly requests a best-effort buffer extension.
    *
@@ -972,7 +1597,7 @@ class TxPipe {
    * User may use `capacity()` to check the total number of available bytes
    * after calling this function or simply use the return value.
    *
-   * @note The capacity will never be extended beyond `TxPipe::kMaxCapacity`.
+   * @note The capacity will never be extended beyond `max_capacity()`.
    *
    * @return The new buffer capacity after extending.
    */
@@ -991,15 +1616,15 @@ class TxPipe {
    * User may use `capacity()` to check the total number of available bytes
    * after calling this function or simply use the return value.
    *
-   * @warning The capacity will never be extended beyond `TxPipe::kMaxCapacity`.
+   * @warning The capacity will never be extended beyond `max_capacity()`.
    *          Therefore, specifying a target capacity larger than
-   *          `TxPipe::kMaxCapacity` will block forever.
+   *          `max_capacity()` will block forever.
    *
    * @return The new buffer capacity after extending.
    */
   inline uint32_t ExtendBufToTarget(uint32_t target_capacity) {
     uint32_t _capacity = capacity();
-    assert(target_capacity <= kMaxCapacity);
+    assert(target_capacity <= max_capacity());
     while (_capacity < target_capacity) {
       _capacity = TryExtendBuf();
     }
@@ -1015,7 +1640,7 @@ class TxPipe {
    * @return The capacity of the allocated buffer in bytes.
    */
   inline uint32_t capacity() const {
-    return (app_end_ - app_begin_ - 1) & kBufMask;
+    return (app_end_ - app_begin_ - 1) & buf_mask_;
   }
 
   /**
@@ -1024,9 +1649,17 @@ class TxPipe {
    * @return Number of bytes pending transmission.
    */
   inline uint32_t pending_transmission() const {
-    return kMaxCapacity - ((app_end_ - app_begin_) & kBufMask);
+    return max_capacity() - ((app_end_ - app_begin_) & buf_mask_);
   }
 
+  /**
+   * @brief Returns the maximum capacity achievable by this pipe. There should
+   *        always be at least one buffer quantum available.
+   *
+   * @return The maximum capacity in bytes.
+   */
+  inline uint32_t max_capacity() const { return buf_mask_ + 1 - kQuantumSize; }
+
   /**
    * @brief Returns the pipe's internal buffer.
    *
@@ -1067,8 +1700,10 @@ class TxPipe {
   static constexpr uint32_t kQuantumSize = 64;
 
   /**
-   * Maximum capacity achievable by the pipe. There should always be at least
-   * one buffer quantum available.
+   * Maximum capacity achievable by a pipe of the default size. There should
+   * always be at least one buffer quantum available.
+   *
+   * @see max_capacity()
    */
   static constexpr uint32_t kMaxCapacity = kEnsoPipeSize * 64 - kQuantumSize;
 
@@ -1081,9 +1716,15 @@ class TxPipe {
    * @param device The `Device` object that instantiated this pipe.
    * @param buf Buffer address to use for the pipe. It must be a pinned
    *            hugepage. If not specified, the buffer is allocated internally.
+   * @param buf_size Size of the buffer in bytes.
    */
-  explicit TxPipe(uint32_t id, Device* device, uint8_t* buf = nullptr) noexcept
-      : kId(id), device_(device), buf_(buf), internal_buf_(buf == nullptr) {}
+  explicit TxPipe(uint32_t id, Device* device, uint8_t* buf = nullptr,
+                  uint32_t buf_size = kEnsoPipeSize * 64) noexcept
+      : kId(id),
+        device_(device),
+        buf_(buf),
+        internal_buf_(buf == nullptr),
+        buf_mask_(buf_size - 1) {}
 
   /**
    * @note TxPipes cannot be deallocated from outside. The `Device` object is in
@@ -1106,12 +1747,7 @@ class TxPipe {
    * @param nb_bytes The number of bytes that have been sent.
    */
   inline void NotifyCompletion(uint32_t nb_bytes) {
-    app_end_ = (app_end_ + nb_bytes) & kBufMask;
-  }
-
-  inline std::string GetHugePageFilePath() const {
-    return device_->huge_page_prefix_ + std::string(kHugePagePathPrefix) +
-           std::to_string(kId);
+    app_end_ = (app_end_ + nb_bytes) & buf_mask_;
   }
 
   friend class Device;
@@ -1123,11 +1759,9 @@ class TxPipe {
   bool internal_buf_;       // If true, the buffer is allocated internally.
   uint32_t app_begin_ = 0;  // The next byte to be sent.
   uint32_t app_end_ = 0;    // The next byte to be allocated.
+  uint32_t hw_end_ = 0;     // The next byte to be handed to the device.
   uint64_t buf_phys_addr_;
-
-  static constexpr uint32_t kBufMask = (kMaxCapacity + kQuantumSize) - 1;
-  static_assert((kBufMask & (kBufMask + 1)) == 0,
-                "(kBufMask + 1) must be a power of 2");
+  const uint32_t buf_mask_;  // Buffer size minus one, the size is a power of 2.
 
   // Buffer layout:
   //                                     | app_begin_          | app_end_
@@ -1154,11 +1788,11 @@ class TxPipe {
   // are in units of 64 bytes. The buffer itself is a circular buffer, so
   // `app_end_` can be smaller than `app_begin_`.
   //
-  // Currently app_begin_ == hw_end_ and app_end_ == hw_begin_. But this may
-  // change in the future. One reason it might be useful to change this is that
-  // currently `Device::Send()` blocks when the notification buffer is full. If
-  // we make sending non-blocking, it may be useful to let the hw_*_ and app_*_
-  // pointers diverge.
+  // Currently app_end_ == hw_begin_, so we do not keep track of hw_begin_.
+  // `SendAndFreeAsync()` may leave app_begin_ ahead of hw_end_ when the device
+  // cannot accept more requests without blocking. The bytes in between form
+  // the pipe's backlog and are handed to the device, in order, by the next
+  // call that sends data.
 };
 
 /**
@@ -1205,7 +1839,7 @@ class RxTxPipe {
    * @copydoc RxPipe::Recv
    */
   inline uint32_t Recv(uint8_t** buf, uint32_t max_nb_bytes) {
-    device_->ProcessCompletions();
+    device_->MaybeProcessCompletions();
     return rx_pipe_->Recv(buf, max_nb_bytes);
   }
 
@@ -1213,7 +1847,7 @@ class RxTxPipe {
    * @copydoc RxPipe::Peek
    */
   inline uint32_t Peek(uint8_t** buf, uint32_t max_nb_bytes) {
-    device_->ProcessCompletions();
+    device_->MaybeProcessCompletions();
     return rx_pipe_->Peek(buf, max_nb_bytes);
   }
 
@@ -1229,7 +1863,7 @@ class RxTxPipe {
    */
   template <typename T>
   inline RxPipe::MessageBatch<T> RecvMessages(int32_t max_nb_messages = -1) {
-    device_->ProcessCompletions();
+    device_->MaybeProcessCompletions();
     return rx_pipe_->RecvMessages<T>(max_nb_messages);
   }
 
@@ -1237,7 +1871,7 @@ class RxTxPipe {
    * @copydoc RxPipe::RecvPkts
    */
   inline RxPipe::MessageBatch<PktIterator> RecvPkts(int32_t max_nb_pkts = -1) {
-    device_->ProcessCompletions();
+    device_->MaybeProcessCompletions();
     return rx_pipe_->RecvPkts(max_nb_pkts);
   }
 
@@ -1246,7 +1880,7 @@ class RxTxPipe {
    */
   inline RxPipe::MessageBatch<PeekPktIterator> PeekPkts(
       int32_t max_nb_pkts = -1) {
-    device_->ProcessCompletions();
+    device_->MaybeProcessCompletions();
     return rx_pipe_->PeekPkts(max_nb_pkts);
   }
 
@@ -1261,6 +1895,18 @@ class RxTxPipe {
    */
   inline void Prefetch() { rx_pipe_->Prefetch(); }
 
+  /**
+   * @copydoc RxPipe::SetHeadUpdateThreshold
+   */
+  inline int SetHeadUpdateThreshold(uint32_t nb_bytes) {
+    return rx_pipe_->SetHeadUpdateThreshold(nb_bytes);
+  }
+
+  /**
+   * @copydoc RxPipe::Flush
+   */
+  inline void Flush() { rx_pipe_->Flush(); }
+
   /**
    * @brief Sends and deallocates a given number of bytes.
    *
@@ -1269,12 +1915,42 @@ class RxTxPipe {
    * equivalent methods for raw packets and messages.
    *
    * @param nb_bytes The number of bytes to send.
+   *
+   * @tparam Park Policy called while blocked, see `Device::Send()`.
    */
+  template <typename Park = fast_path::CallbackPark>
   inline void SendAndFree(uint32_t nb_bytes) {
-    tx_pipe_->SendAndFree(nb_bytes);
+    tx_pipe_->SendAndFree<Park>(nb_bytes);
     last_tx_pipe_capacity_ -= nb_bytes;
   }
 
+  /**
+   * @brief Sends and deallocates a given number of bytes, without blocking.
+   *
+   * Same restrictions as `SendAndFree()`. Bytes that cannot be handed to the
+   * device right away are kept in the backlog.
+   *
+   * @see TxPipe::SendAndFreeAsync()
+   *
+   * @param nb_bytes The number of bytes to send.
+   *
+   * @return The number of bytes that remain in the backlog.
+   */
+  inline uint32_t SendAndFreeAsync(uint32_t nb_bytes) {
+    last_tx_pipe_capacity_ -= nb_bytes;
+    return tx_pipe_->SendAndFreeAsync(nb_bytes);
+  }
+
+  /**
+   * @copydoc TxPipe::TrySendBacklog
+   */
+  inline uint32_t TrySendBacklog() { return tx_pipe_->TrySendBacklog(); }
+
+  /**
+   * @copydoc TxPipe::backlog
+   */
+  inline uint32_t backlog() const { return tx_pipe_->backlog(); }
+
   /**
    * @brief Process completions for this pipe, potentially freeing up space to
    * receive more data.
@@ -1333,6 +2009,11 @@ class RxTxPipe {
     rx_pipe_->set_context(new_context);
   }
 
+  /**
+   * @copydoc RxPipe::max_capacity
+   */
+  inline uint32_t max_capacity() const { return rx_pipe_->max_capacity(); }
+
   /**
    * @copydoc RxPipe::kQuantumSize
    */
@@ -1353,7 +2034,9 @@ class RxTxPipe {
    * Threshold for processing completions. If the RX pipe's capacity is greater
    * than this threshold, we process completions.
    */
-  static constexpr uint32_t kCompletionsThreshold = kEnsoPipeSize * 64 / 2;
+  inline uint32_t completions_threshold() const {
+    return rx_pipe_->buf_size() / 2;
+  }
 
   /**
    * @brief Set the cycles at which that a packet
@@ -1382,17 +2065,131 @@ class RxTxPipe {
    * @brief Initializes the RX/TX pipe.
    *
    * @param fallback Whether this pipe is a fallback pipe.
+   * @param buf_size Size of the pipe's buffer in bytes.
    *
    * @return 0 on success and a non-zero error code on failure.
    */
-  int Init(bool fallback) noexcept;
+  int Init(bool fallback, uint32_t buf_size) noexcept;
 
   friend class Device;
+  friend class PipeGroup;
 
   Device* device_;
   RxPipe* rx_pipe_;
   TxPipe* tx_pipe_;
   uint32_t last_tx_pipe_capacity_;
+  bool has_completions_ = false;  ///< In `Device::completed_rx_tx_pipes_`.
+};
+
+/**
+ * @brief A group of RX pipes that are polled together.
+ *
+ * Keeps the state needed to tell whether a pipe has new data in contiguous
+ * arrays, so that polling many mostly idle pipes touches a few cache lines
+ * rather than every pipe. Should be allocated with
+ * `Device::AllocatePipeGroup()`.
+ *
+ * Example:
+ * @code
+ *    PipeGroup* group = device->AllocatePipeGroup();
+ *    for (auto& pipe : pipes) {
+ *      group->Add(pipe);
+ *    }
+ *
+ *    uint32_t indices[kBatchSize];
+ *    uint32_t nb_pipes = group->PollAll(indices, kBatchSize);
+ *    for (uint32_t i = 0; i < nb_pipes; ++i) {
+ *      RxPipe* pipe = group->rx_pipe(indices[i]);
+ *      auto batch = pipe->RecvPkts();
+ *      // [...]
+ *    }
+ * @endcode
+ */
+class PipeGroup {
+ public:
+  PipeGroup(const PipeGroup&) = delete;
+  PipeGroup& operator=(const PipeGroup&) = delete;
+  PipeGroup(PipeGroup&&) = delete;
+  PipeGroup& operator=(PipeGroup&&) = delete;
+
+  /**
+   * @brief Adds an RX pipe to the group.
+   *
+   * The pipe must have been allocated by the same device as the group and
+   * must not be freed while it is in the group.
+   *
+   * @param pipe Pipe to add.
+   * @return Index of the pipe in the group or -1 on failure.
+   */
+  int Add(RxPipe* pipe) noexcept;
+
+  /**
+   * @brief Adds the RX side of an RX/TX pipe to the group.
+   *
+   * @param pipe Pipe to add.
+   * @return Index of the pipe in the group or -1 on failure.
+   */
+  int Add(RxTxPipe* pipe) noexcept;
+
+  /**
+   * @brief Finds the pipes in the group that received new data.
+   *
+   * Consumes new notifications from the device and compares the latest tail of
+   * every pipe with the tail it had when it was last received from. Pipes that
+   * are returned are also prefetched, and receiving from them does not consume
+   * notifications again. Scanning resumes after the last pipe returned by the
+   * previous call, so that all pipes are eventually returned even if
+   * `max_nb_pipes` is small.
+   *
+   * A pipe may occasionally be returned without new data, e.g., if it was
+   * received from without being returned by this method.
+   *
+   * @param indices Array where the indices of the pipes will be stored.
+   * @param max_nb_pipes Maximum number of indices to store in `indices`.
+   *
+   * @return The number of indices stored in `indices`.
+   */
+  uint32_t PollAll(uint32_t* indices, uint32_t max_nb_pipes) noexcept;
+
+  /**
+   * @brief Returns the RX pipe with the given index in the group.
+   */
+  inline RxPipe* rx_pipe(uint32_t index) const { return rx_pipes_[index]; }
+
+  /**
+   * @brief Returns the number of pipes in the group.
+   */
+  inline uint32_t size() const { return rx_pipes_.size(); }
+
+ private:
+  /**
+   * PipeGroups can only be instantiated from a `Device` object, using the
+   * `AllocatePipeGroup()` method.
+   */
+  explicit PipeGroup(Device* device) noexcept
+      : notification_buf_pair_(&(device->notification_buf_pair_)) {}
+
+  /**
+   * @brief Appends to `indices` the pipes in [`begin`, `end`) with new data.
+   *
+   * @return The new number of indices in `indices`, at most `max_nb_pipes`.
+   */
+  uint32_t ScanPipes(uint32_t begin, uint32_t end, uint32_t* indices,
+                     uint32_t nb_indices, uint32_t max_nb_pipes) noexcept;
+
+  friend class Device;
+
+  struct NotificationBufPair* notification_buf_pair_;
+
+  // Per-pipe state, indexed by the pipe's index in the group. Only the pipes
+  // returned by `PollAll()` have their `RxPipe` accessed.
+  std::vector<uint32_t> slots_;     ///< Slot in the notification buffer.
+  std::vector<uint32_t> rx_tails_;  ///< Tail when the pipe was last received.
+  std::vector<uint8_t*> bufs_;      ///< Start of the pipe's buffer.
+  std::vector<RxPipe*> rx_pipes_;
+
+  std::vector<uint32_t> polled_;  ///< Pipes returned by the last `PollAll()`.
+  uint32_t next_index_ = 0;       ///< Where the next scan starts.
 };
 
 /**
@@ -1533,6 +2330,93 @@ class PeekPktIterator : public MessageIteratorBase<PeekPktIterator> {
   constexpr void OnAdvanceMessage([[maybe_unused]] uint32_t nb_bytes) {}
 };
 
+template <typename UpdateFn>
+uint32_t Device::NextRxPipesToRecv(RxPipe** pipes, uint32_t max_nb_pipes,
+                                   const UpdateFn& update_packet) {
+  struct NotificationBufPair* notification_buf_pair = &notification_buf_pair_;
+  uint16_t next_rx_ids_head = notification_buf_pair->next_rx_ids_head;
+
+  if (next_rx_ids_head == notification_buf_pair->next_rx_ids_tail) {
+    fast_path::get_new_tails<fast_path::FastPathMmio>(notification_buf_pair,
+                                                      update_packet);
+  }
+  uint16_t next_rx_ids_tail = notification_buf_pair->next_rx_ids_tail;
+
+  // Pipes that were already returned in this burst have `burst_id_` set to the
+  // current burst. Their pending tail already reflects the latest notification
+  // so we can skip them. Pipes start with `burst_id_` 0, so 0 is never used.
+  if (unlikely(++burst_id_ == 0)) {
+    burst_id_ = 1;
+  }
+  uint32_t burst_id = burst_id_;
+  uint32_t nb_pipes = 0;
+
+  for (uint32_t i = 0; i < kBatchSize; ++i) {
+    if (next_rx_ids_head == next_rx_ids_tail || nb_pipes == max_nb_pipes) {
+      break;
+    }
+    struct RxNotification* notification =
+        notification_buf_pair->next_rx_pipe_notifs[next_rx_ids_head];
+    next_rx_ids_head = (next_rx_ids_head + 1) % kNextRxNotifsSize;
+
+    RxPipe* rx_pipe = GetRxPipe(notification->queue_id);
+    if (unlikely(!rx_pipe) || rx_pipe->burst_id_ == burst_id) {
+      continue;
+    }
+    rx_pipe->burst_id_ = burst_id;
+    rx_pipe->SetAsNextPipe();
+    pipes[nb_pipes++] = rx_pipe;
+  }
+
+  notification_buf_pair->next_rx_ids_head = next_rx_ids_head;
+
+  return nb_pipes;
+}
+
+template <typename T>
+uint32_t Device::RecvBurst(RxPipe** pipes, MessageBatch<T>* batches,
+                           uint32_t max_nb_pipes) {
+  // This function can only be used when there are **no** RxTx pipes.
+  assert(rx_tx_pipes_.size() == 0);
+
+  uint32_t nb_pipes = NextRxPipesToRecv(pipes, max_nb_pipes);
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    batches[i] = pipes[i]->template RecvMessages<T>();
+  }
+  return nb_pipes;
+}
+
+template <typename T>
+uint32_t Device::RecvBurst(RxTxPipe** pipes, MessageBatch<T>* batches,
+                           uint32_t max_nb_pipes) {
+  MaybeProcessCompletions();
+  // This function can only be used when there are only RxTx pipes.
+  assert(rx_pipes_.size() == rx_tx_pipes_.size());
+
+  // RxTxPipes use the same ID as their underlying RxPipe, we can therefore
+  // reuse the output array to store the RxPipes.
+  static_assert(sizeof(RxPipe*) == sizeof(RxTxPipe*));
+  RxPipe** rx_pipes = reinterpret_cast<RxPipe**>(pipes);
+  uint32_t nb_pipes = NextRxPipesToRecv(
+      rx_pipes, max_nb_pipes,
+      [this](enso_pipe_id_t enso_pipe_id, uint64_t sent_time,
+             uint32_t prev_tail) {
+        RxTxPipe* rx_tx_pipe = GetRxTxPipe(enso_pipe_id);
+        rx_tx_pipe->SetPktSentTime(prev_tail, sent_time);
+      });
+
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    RxTxPipe* rx_tx_pipe =
+        rx_tx_pipes_by_slot_[rx_pipes[i]->internal_rx_pipe_.slot];
+    pipes[i] = rx_tx_pipe;
+
+    // Completions were already processed for the whole burst, so we bypass
+    // `RxTxPipe::RecvMessages()`.
+    batches[i] = rx_tx_pipe->rx_pipe_->template RecvMessages<T>();
+  }
+  return nb_pipes;
+}
+
 }  // namespace enso
 
 #endif  // ENSO_SOFTWARE_INCLUDE_ENSO_PIPE_H_
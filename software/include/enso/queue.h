@@ -42,9 +42,12 @@
 
 #include <enso/consts.h>
 #include <enso/helpers.h>
+#include <enso/wait.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
@@ -55,11 +58,6 @@
 
 namespace enso {
 
-// This implementation assumes AVX512.
-#ifndef __AVX512F__
-#error "Need support for AVX512F to use Queue."
-#endif  // __AVX512F__
-
 template <typename T>
 static constexpr T align_cache_power_two(T value) {
   T cache_aligned = (value + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
@@ -70,6 +68,72 @@ static constexpr T align_cache_power_two(T value) {
   return power_two;
 }
 
+/**
+ * @brief Maps the shared buffer of a queue, creating it if it does not exist.
+ *
+ * @param path Path of the buffer. The buffer size is appended to it.
+ * @param size Size of the buffer in bytes.
+ * @param join_if_exists If true, the buffer will be joined if it already
+ *        exists. If false, the mapping will fail if the buffer already exists.
+ * @param mirror Whether to map the buffer again right after itself.
+ * @param created Set to true if the buffer did not exist and false otherwise.
+ * @return The address of the buffer or nullptr on failure.
+ */
+inline void* map_queue_buf(std::string* path, size_t size, bool join_if_exists,
+                           bool mirror, bool* created) noexcept {
+  // Check if a file starting with path exists.
+  std::filesystem::path fs_path = std::filesystem::path(*path);
+  std::filesystem::path dir_path = fs_path.parent_path();
+  std::string file_name = fs_path.filename();
+
+  bool create_queue = true;
+  for (const auto& entry : std::filesystem::directory_iterator(dir_path)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+
+    std::string entry_name = entry.path().filename().string();
+
+    // File starting with file_name exists.
+    if (entry_name.find(file_name) == 0) {
+      std::string size_str = entry_name.substr(file_name.size());
+
+      // Check if the string is a number.
+      if (size_str.find_first_not_of("0123456789") != std::string::npos) {
+        std::cerr << "Found existing queue with invalid size: " << size_str
+                  << std::endl;
+        return nullptr;
+      }
+
+      size_t existing_size = std::stoul(size_str);
+
+      if (existing_size != size) {
+        std::cerr << "Found existing queue with different size: "
+                  << existing_size << std::endl;
+        return nullptr;
+      }
+
+      create_queue = false;
+    }
+  }
+
+  if (!join_if_exists && !create_queue) {
+    std::cerr << "Queue already exists" << std::endl;
+    return nullptr;
+  }
+
+  *created = create_queue;
+  *path += std::to_string(size);
+
+  void* addr = get_huge_page(*path, size, mirror);
+  if (addr == nullptr) {
+    std::cerr << "Failed to allocate shared memory" << std::endl;
+    return nullptr;
+  }
+
+  return addr;
+}
+
 /**
  * @brief Queue parent class.
  *
@@ -114,7 +178,8 @@ class Queue {
 
   ~Queue() noexcept {
     if (buf_addr_ != nullptr) {
-      munmap(buf_addr_, size_);
+      // `get_huge_page` maps twice the requested size.
+      munmap(header_addr_, size_ * 2);
       if (created_queue_) {
         unlink(huge_page_path_.c_str());
       }
@@ -194,9 +259,12 @@ class Queue {
    * @param join_if_exists If true, the queue will be joined if it already
    *        exists. If false, the creation will fail if the queue already
    *        exists.
+   * @param header_size Number of bytes to reserve at the start of the shared
+   *        buffer for state shared by all users of the queue. Elements use
+   *        the largest power of two number of slots that fit after it.
    * @return 0 on success and a non-zero error code on failure.
    */
-  int Init(bool join_if_exists) noexcept {
+  int Init(bool join_if_exists, size_t header_size = 0) noexcept {
     if (size_ == 0) {
       size_ = kBufPageSize;
     }
@@ -206,73 +274,36 @@ class Queue {
       return -1;
     }
 
-    if (size_ < sizeof(struct Element)) {
-      std::cerr << "Queue size must be at least " << sizeof(struct Element)
-                << " bytes" << std::endl;
+    if (size_ < header_size + sizeof(struct Element)) {
+      std::cerr << "Queue size must be at least "
+                << header_size + sizeof(struct Element) << " bytes"
+                << std::endl;
       return -1;
     }
 
-    capacity_ = size_ / sizeof(struct Element);
+    uint32_t nb_slots = (size_ - header_size) / sizeof(struct Element);
+    capacity_ = 1;
+    while (capacity_ * 2 <= nb_slots) {
+      capacity_ *= 2;
+    }
     index_mask_ = capacity_ - 1;
 
     // Keep path so that we can unlink it later if needed.
     huge_page_path_ =
         huge_page_prefix_ + std::string(kHugePageQueuePathPrefix) + queue_name_;
 
-    // Check if a file starting with huge_page_path_ exists.
-    std::filesystem::path path = std::filesystem::path(huge_page_path_);
-    std::filesystem::path dir_path = path.parent_path();
-    std::string file_name = path.filename();
-
-    bool create_queue = true;
-    for (const auto& entry : std::filesystem::directory_iterator(dir_path)) {
-      if (!entry.is_regular_file()) {
-        continue;
-      }
-
-      std::string entry_name = entry.path().filename().string();
-
-      // File starting with file_name exists.
-      if (entry_name.find(file_name) == 0) {
-        std::string size_str = entry_name.substr(file_name.size());
-
-        // Check if the string is a number.
-        if (size_str.find_first_not_of("0123456789") != std::string::npos) {
-          std::cerr << "Found existing queue with invalid size: " << size_str
-                    << std::endl;
-          return -1;
-        }
-
-        size_t existing_size = std::stoul(size_str);
-
-        if (existing_size != size_) {
-          std::cerr << "Found existing queue with different size: "
-                    << existing_size << std::endl;
-          return -1;
-        }
-
-        create_queue = false;
-      }
-    }
-
-    if (!join_if_exists && !create_queue) {
-      std::cerr << "Queue already exists" << std::endl;
-      return -1;
-    }
-
-    created_queue_ = create_queue;
-    huge_page_path_ += std::to_string(size_);
-
-    void* addr = get_huge_page(huge_page_path_, size_);
+    void* addr = map_queue_buf(&huge_page_path_, size_, join_if_exists, false,
+                               &created_queue_);
     if (addr == nullptr) {
-      std::cerr << "Failed to allocate shared memory" << std::endl;
       return -1;
     }
 
-    buf_addr_ = reinterpret_cast<Element*>(addr);
+    header_addr_ = addr;
+    buf_addr_ = reinterpret_cast<Element*>(
+        reinterpret_cast<uint8_t*>(addr) + header_size);
 
-    if (create_queue) {
-      memset(buf_addr_, 0, size_);
+    if (created_queue_) {
+      memset(header_addr_, 0, size_);
     }
 
     return 0;
@@ -282,6 +313,11 @@ class Queue {
 
   inline uint32_t index_mask() const noexcept { return index_mask_; }
 
+  /**
+   * @brief Returns the address of the header reserved with `Init()`.
+   */
+  inline void* header_addr() const noexcept { return header_addr_; }
+
  private:
   Queue(const Queue& other) = delete;
   Queue& operator=(const Queue& other) = delete;
@@ -289,6 +325,7 @@ class Queue {
   size_t size_;
   uint32_t capacity_;  // In number of elements.
   uint32_t index_mask_;
+  void* header_addr_ = nullptr;
   Element* buf_addr_ = nullptr;
   std::string huge_page_path_;
   bool created_queue_ = false;
@@ -314,13 +351,7 @@ class QueueProducer : public Queue<T, QueueProducer<T>> {
       return -1;  // Queue is full.
     }
 
-    __m512i tmp_element_raw;
-    struct Parent::Element* tmp_element =
-        (struct Parent::Element*)(&tmp_element_raw);
-    tmp_element->signal = 1;
-    tmp_element->data = data;
-
-    _mm512_storeu_si512((__m512i*)current_element, tmp_element_raw);
+    WriteElement(current_element, data);
 
     _enso_compiler_memory_barrier();
     tail_ = (tail_ + 1);
@@ -328,6 +359,46 @@ class QueueProducer : public Queue<T, QueueProducer<T>> {
     return 0;
   }
 
+  /**
+   * @brief Pushes up to `nb_elements` elements to the queue.
+   *
+   * Elements are written one cache line at a time and the compiler
+   * barriers are paid once for the whole batch. Elements are pushed in order
+   * until the queue is full.
+   *
+   * @param data Array with the elements to push.
+   * @param nb_elements Number of elements in `data`.
+   * @return The number of elements pushed.
+   */
+  inline uint32_t PushBatch(const T* data, uint32_t nb_elements) {
+    _enso_compiler_memory_barrier();
+
+    struct Parent::Element* buf = Parent::buf_addr();
+    uint32_t index_mask = Parent::index_mask();
+    uint32_t nb_free = std::min(nb_elements, Parent::capacity());
+
+    // The consumer frees elements in order, so if the last element we need is
+    // free, all the ones before it are too.
+    if (nb_free > 0 && buf[(tail_ + nb_free - 1) & index_mask].signal) {
+      uint32_t nb_needed = nb_free;
+      nb_free = 0;
+      while (nb_free < nb_needed &&
+             !buf[(tail_ + nb_free) & index_mask].signal) {
+        ++nb_free;
+      }
+    }
+
+    for (uint32_t i = 0; i < nb_free; ++i) {
+      WriteElement(&buf[(tail_ + i) & index_mask], data[i]);
+    }
+
+    _enso_compiler_memory_barrier();
+
+    tail_ = (tail_ + nb_free);
+
+    return nb_free;
+  }
+
   /**
    * @brief Get the current tail of the queue, where the next message will be
    * pushed.
@@ -386,6 +457,31 @@ class QueueProducer : public Queue<T, QueueProducer<T>> {
   using Parent = Queue<T, QueueProducer<T>>;
   friend Parent;
 
+  /**
+   * @brief Writes `data` to `element` and sets its signal. The consumer never
+   *        sees the signal before the data.
+   */
+  static _enso_always_inline void WriteElement(
+      struct Parent::Element* element, const T& data) {
+#if defined(__AVX512F__)
+    // The whole element is written with a single 64-byte store.
+    __m512i tmp_element_raw = _mm512_setzero_si512();
+    struct Parent::Element* tmp_element =
+        (struct Parent::Element*)(&tmp_element_raw);
+    tmp_element->signal = 1;
+    tmp_element->data = data;
+
+    _mm512_store_si512((__m512i*)element, tmp_element_raw);
+#else
+    // Assembling the element elsewhere and copying it with narrower vectors
+    // stalls on store forwarding. Instead, we write the data in place and
+    // rely on stores becoming visible in program order.
+    element->data = data;
+    _enso_compiler_memory_barrier();
+    element->signal = 1;
+#endif  // __AVX512F__
+  }
+
   uint32_t tail_ = 0;
   uint32_t* head_addr_ = nullptr;
   int32_t application_id_ = -1;
@@ -439,6 +535,71 @@ class QueueConsumer : public Queue<T, QueueConsumer<T>> {
     return data;
   }
 
+  /**
+   * @brief Pops data from the queue, waiting for it if the queue is empty.
+   *
+   * @param strategy How to wait while the queue is empty.
+   * @return the data.
+   */
+  inline T PopBlocking(const WaitStrategy& strategy = WaitStrategy()) {
+    Waiter waiter(strategy);
+    std::optional<T> data;
+    while (!(data = Pop())) {
+      // `Pop()` may have updated `head_` from the shared head.
+      struct Parent::Element* current_element =
+          &(Parent::buf_addr()[head_ & Parent::index_mask()]);
+      // Only the low half of the signal is watched, it is 0 while empty.
+      waiter.Wait(
+          reinterpret_cast<volatile uint32_t*>(&current_element->signal), 0);
+    }
+    return *data;
+  }
+
+  /**
+   * @brief Pops up to `max_nb_elements` elements from the queue.
+   *
+   * Elements are copied out before any of their signals are cleared, and the
+   * shared head (if any) is read and written once for the whole batch.
+   *
+   * @param data Array where the popped elements will be stored. Must have
+   *        space for at least `max_nb_elements` elements.
+   * @param max_nb_elements Maximum number of elements to pop.
+   * @return The number of elements popped.
+   */
+  inline uint32_t PopBatch(T* data, uint32_t max_nb_elements) {
+    if (application_id_ >= 0) head_ = *head_addr_;
+    _enso_compiler_memory_barrier();
+
+    struct Parent::Element* buf = Parent::buf_addr();
+    uint32_t index_mask = Parent::index_mask();
+
+    // Signals are only cleared after the loop, so we must not wrap around.
+    max_nb_elements = std::min(max_nb_elements, Parent::capacity());
+
+    uint32_t nb_elements = 0;
+    while (nb_elements < max_nb_elements) {
+      struct Parent::Element* current_element =
+          &buf[(head_ + nb_elements) & index_mask];
+      if (!current_element->signal) {
+        break;
+      }
+      data[nb_elements] = current_element->data;
+      ++nb_elements;
+    }
+
+    _enso_compiler_memory_barrier();
+
+    // Free elements in order, `QueueProducer::PushBatch()` relies on it.
+    for (uint32_t i = 0; i < nb_elements; ++i) {
+      buf[(head_ + i) & index_mask].signal = 0;
+    }
+
+    if (application_id_ >= 0) *head_addr_ = (head_ + nb_elements);
+    head_ = (head_ + nb_elements);
+
+    return nb_elements;
+  }
+
   /**
    * @brief Get the head of the queue, where the next message will be popped.
    */
@@ -508,6 +669,554 @@ class QueueConsumer : public Queue<T, QueueConsumer<T>> {
   std::string huge_page_prefix_;
 };
 
+/**
+ * @brief Parent class of the MPMC queue producer and consumer.
+ *
+ * Producers and consumers claim elements by atomically advancing positions
+ * that are kept in the header of the shared buffer. The `signal` of every
+ * element holds a sequence number that tells whether the element is ready to
+ * be written or read for a given position. The header takes the first two
+ * cache lines, so a queue holds half as many elements as a single-producer
+ * queue of the same size.
+ *
+ * @note The queue must be created (by any producer or consumer) before other
+ *       threads join it, as the first one to create it also initializes it.
+ */
+template <typename T, typename Subclass>
+class MpmcQueue : public Queue<T, Subclass> {
+ protected:
+  // Kept in separate cache lines so that producers and consumers do not
+  // contend for the same line.
+  struct Header {
+    alignas(kCacheLineSize) uint64_t enqueue_pos;
+    alignas(kCacheLineSize) uint64_t dequeue_pos;
+  };
+
+  explicit MpmcQueue(const std::string& queue_name, size_t size,
+                     const std::string& huge_page_prefix) noexcept
+      : Queue<T, Subclass>(queue_name, size, huge_page_prefix) {}
+
+  /**
+   * @copydoc Queue::Init
+   */
+  int Init(bool join_if_exists) noexcept {
+    if (Parent::Init(join_if_exists, sizeof(Header))) {
+      return -1;
+    }
+
+    // Every element starts ready to be written at its own position.
+    if (Parent::created_queue()) {
+      for (uint32_t i = 0; i < Parent::capacity(); ++i) {
+        Parent::buf_addr()[i].signal = i;
+      }
+    }
+
+    header_ = reinterpret_cast<Header*>(Parent::header_addr());
+
+    return 0;
+  }
+
+  Header* header_ = nullptr;
+
+ private:
+  using Parent = Queue<T, Subclass>;
+};
+
+/**
+ * @brief Producer side of a queue that may have multiple producers and
+ *        multiple consumers.
+ *
+ * Unlike `QueueProducer`, any number of threads (or processes) may push to the
+ * same queue, each using its own `MpmcQueueProducer` created with the same
+ * queue name. Consumers must use `MpmcQueueConsumer`.
+ *
+ * Example:
+ *   // Consumer, creates the queue.
+ *   std::unique_ptr<MpmcQueueConsumer<int>> queue_consumer =
+ *      MpmcQueueConsumer<int>::Create("queue_name");
+ *
+ *   // On every producer thread.
+ *   std::unique_ptr<MpmcQueueProducer<int>> queue_producer =
+ *     MpmcQueueProducer<int>::Create("queue_name");
+ *   queue_producer->Push(42);
+ *
+ * @see MpmcQueue
+ */
+template <typename T>
+class MpmcQueueProducer : public MpmcQueue<T, MpmcQueueProducer<T>> {
+ public:
+  /**
+   * @brief Pushes data to the queue.
+   *
+   * Safe to call concurrently with other producers.
+   *
+   * @param data data to push.
+   * @return 0 on success and a non-zero error code on failure.
+   */
+  inline int Push(const T& data) {
+    struct Parent::Element* element;
+    uint64_t pos = __atomic_load_n(&header_->enqueue_pos, __ATOMIC_RELAXED);
+    while (true) {
+      element = &(Parent::buf_addr()[pos & Parent::index_mask()]);
+      uint64_t seq = __atomic_load_n(&element->signal, __ATOMIC_ACQUIRE);
+      int64_t diff = static_cast<int64_t>(seq - pos);
+      if (diff == 0) {
+        // The element is free, try to claim it.
+        if (__atomic_compare_exchange_n(&header_->enqueue_pos, &pos, pos + 1,
+                                        true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return -1;  // Queue is full.
+      } else {
+        // Another producer claimed this position.
+        pos = __atomic_load_n(&header_->enqueue_pos, __ATOMIC_RELAXED);
+      }
+    }
+
+    element->data = data;
+    __atomic_store_n(&element->signal, pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+  }
+
+ protected:
+  explicit MpmcQueueProducer(const std::string& queue_name,
+                             [[maybe_unused]] int32_t application_id,
+                             [[maybe_unused]] uint32_t id, size_t size,
+                             const std::string& huge_page_prefix) noexcept
+      : MpmcQueue<T, MpmcQueueProducer<T>>(queue_name, size,
+                                          huge_page_prefix) {}
+
+ private:
+  using Parent = MpmcQueue<T, MpmcQueueProducer<T>>;
+  friend Queue<T, MpmcQueueProducer<T>>;
+  using Parent::header_;
+};
+
+/**
+ * @brief Consumer side of a queue that may have multiple producers and
+ *        multiple consumers.
+ *
+ * Any number of threads (or processes) may pop from the same queue, each using
+ * its own `MpmcQueueConsumer` created with the same queue name. A single
+ * consumer with many producers also works, making this a fan-in queue.
+ *
+ * @see MpmcQueueProducer
+ */
+template <typename T>
+class MpmcQueueConsumer : public MpmcQueue<T, MpmcQueueConsumer<T>> {
+ public:
+  /**
+   * @brief Pops data from the queue.
+   *
+   * Safe to call concurrently with other consumers.
+   *
+   * @return the data on success and an empty optional if the queue is empty.
+   */
+  inline std::optional<T> Pop() {
+    struct Parent::Element* element;
+    uint64_t pos = __atomic_load_n(&header_->dequeue_pos, __ATOMIC_RELAXED);
+    while (true) {
+      element = &(Parent::buf_addr()[pos & Parent::index_mask()]);
+      uint64_t seq = __atomic_load_n(&element->signal, __ATOMIC_ACQUIRE);
+      int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+      if (diff == 0) {
+        // The element is ready, try to claim it.
+        if (__atomic_compare_exchange_n(&header_->dequeue_pos, &pos, pos + 1,
+                                        true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return {};  // Queue is empty.
+      } else {
+        // Another consumer claimed this position.
+        pos = __atomic_load_n(&header_->dequeue_pos, __ATOMIC_RELAXED);
+      }
+    }
+
+    T data = element->data;
+
+    // Ready to be written again once producers wrap around.
+    __atomic_store_n(&element->signal, pos + Parent::capacity(),
+                     __ATOMIC_RELEASE);
+
+    return data;
+  }
+
+  /**
+   * @brief Returns if the queue is empty.
+   */
+  inline bool IsEmpty() {
+    uint64_t pos = __atomic_load_n(&header_->dequeue_pos, __ATOMIC_RELAXED);
+    struct Parent::Element* element =
+        &(Parent::buf_addr()[pos & Parent::index_mask()]);
+    return __atomic_load_n(&element->signal, __ATOMIC_ACQUIRE) != pos + 1;
+  }
+
+ protected:
+  explicit MpmcQueueConsumer(const std::string& queue_name,
+                             [[maybe_unused]] int32_t application_id,
+                             [[maybe_unused]] uint32_t id, size_t size,
+                             const std::string& huge_page_prefix) noexcept
+      : MpmcQueue<T, MpmcQueueConsumer<T>>(queue_name, size,
+                                          huge_page_prefix) {}
+
+ private:
+  using Parent = MpmcQueue<T, MpmcQueueConsumer<T>>;
+  friend Queue<T, MpmcQueueConsumer<T>>;
+  using Parent::header_;
+};
+
+/**
+ * @brief Byte queue parent class.
+ *
+ * Unlike `Queue`, which moves fixed-size elements that fit in a cache line,
+ * a byte queue moves variable-length records between a single producer and a
+ * single consumer. It should be instantiated using either the
+ * ByteQueueProducer or ByteQueueConsumer classes through the Create method.
+ *
+ * Every record starts at a cache line boundary with a small header holding its
+ * length and state, followed by the data. The buffer is mirrored, so records
+ * that wrap around the end of the buffer are still contiguous in memory. The
+ * producer can reserve space and write records in place, and the consumer can
+ * read them in place before releasing them.
+ *
+ * Example:
+ *   // Producer.
+ *   std::unique_ptr<ByteQueueProducer> queue_producer =
+ *     ByteQueueProducer::Create("queue_name");
+ *
+ *   // Consumer.
+ *   std::unique_ptr<ByteQueueConsumer> queue_consumer =
+ *      ByteQueueConsumer::Create("queue_name");
+ *
+ *   uint8_t* record = queue_producer->Reserve(1500);
+ *   uint32_t nb_bytes = build_message(record);
+ *   queue_producer->Commit(nb_bytes);
+ *
+ *   uint8_t* data = queue_consumer->Peek(&nb_bytes);
+ *   if (data != nullptr) {
+ *     process_message(data, nb_bytes);
+ *     queue_consumer->Release();
+ *   }
+ */
+template <typename Subclass>
+class ByteQueue {
+ public:
+  ~ByteQueue() noexcept {
+    if (buf_addr_ != nullptr) {
+      // `get_huge_page` maps twice the requested size.
+      munmap(buf_addr_, size_ * 2);
+      if (created_queue_) {
+        unlink(huge_page_path_.c_str());
+      }
+    }
+  }
+
+  ByteQueue(ByteQueue&& other) = default;
+  ByteQueue& operator=(ByteQueue&& other) = default;
+
+  /**
+   * @brief Factory method to create a ByteQueue object.
+   *
+   * @param queue_name Global queue name.
+   * @param size Size of the queue (in bytes). Must be a multiple of
+   *        kBufPageSize. If zero (default), the size will be set to
+   *        kBufPageSize.
+   * @param join_if_exists If true (default), the queue will be joined if it
+   *       already exists. If false, the creation will fail if the queue already
+   *       exists.
+   * @param huge_page_prefix Prefix to use when creating the shared memory
+   *       file. If empty (default), the default prefix will be used.
+   * @return A unique pointer to the object or nullptr if the creation fails.
+   */
+  static std::unique_ptr<Subclass> Create(
+      const std::string& queue_name, size_t size = 0,
+      bool join_if_exists = true, std::string huge_page_prefix = "") noexcept {
+    if (huge_page_prefix == "") {
+      huge_page_prefix = kHugePageDefaultPrefix;
+    }
+
+    std::unique_ptr<Subclass> queue(
+        new (std::nothrow) Subclass(queue_name, size, huge_page_prefix));
+
+    if (queue == nullptr) {
+      return std::unique_ptr<Subclass>{};
+    }
+
+    if (queue->Init(join_if_exists)) {
+      return std::unique_ptr<Subclass>{};
+    }
+
+    return queue;
+  }
+
+  /**
+   * @brief Returns the size of the internal buffer.
+   * @return The size of the internal buffer.
+   */
+  inline size_t size() const noexcept { return size_; }
+
+  /**
+   * @brief Returns the largest record that fits in the queue.
+   * @return The maximum number of bytes in a record.
+   */
+  inline uint32_t max_record_size() const noexcept {
+    return size_ - sizeof(struct RecordHeader);
+  }
+
+ protected:
+  struct RecordHeader {
+    uint32_t nb_bytes;
+    uint32_t state;
+  };
+
+  // Record states. Memory starts zeroed, so records that were never written
+  // are empty.
+  static constexpr uint32_t kRecordEmpty = 0;
+  static constexpr uint32_t kRecordReady = 1;
+  static constexpr uint32_t kRecordReleased = 2;
+
+  explicit ByteQueue(const std::string& queue_name, size_t size,
+                     const std::string& huge_page_prefix) noexcept
+      : size_(size),
+        queue_name_(queue_name),
+        huge_page_prefix_(huge_page_prefix) {}
+
+  /**
+   * @brief Initializes the ByteQueue object.
+   *
+   * @param join_if_exists If true, the queue will be joined if it already
+   *        exists. If false, the creation will fail if the queue already
+   *        exists.
+   * @return 0 on success and a non-zero error code on failure.
+   */
+  int Init(bool join_if_exists) noexcept {
+    if (size_ == 0) {
+      size_ = kBufPageSize;
+    }
+
+    if ((size_ & (size_ - 1)) != 0 || size_ % kBufPageSize != 0) {
+      std::cerr << "Byte queue size must be a power of two multiple of "
+                << kBufPageSize << " bytes" << std::endl;
+      return -1;
+    }
+
+    // Keep path so that we can unlink it later if needed.
+    huge_page_path_ = huge_page_prefix_ +
+                      std::string(kHugePageByteQueuePathPrefix) + queue_name_;
+
+    void* addr = map_queue_buf(&huge_page_path_, size_, join_if_exists, true,
+                               &created_queue_);
+    if (addr == nullptr) {
+      return -1;
+    }
+
+    buf_addr_ = reinterpret_cast<uint8_t*>(addr);
+
+    if (created_queue_) {
+      memset(buf_addr_, 0, size_);
+    }
+
+    return 0;
+  }
+
+  /**
+   * @brief Returns the size of a record with `nb_bytes` of data, including
+   *        its header and padding.
+   */
+  static inline uint64_t record_size(uint32_t nb_bytes) noexcept {
+    return (sizeof(struct RecordHeader) + nb_bytes + kCacheLineSize - 1) &
+           ~(uint64_t)(kCacheLineSize - 1);
+  }
+
+  /**
+   * @brief Returns the header of the record at the given position.
+   */
+  inline struct RecordHeader* record_header(uint64_t pos) const noexcept {
+    return reinterpret_cast<struct RecordHeader*>(buf_addr_ +
+                                                  (pos & (size_ - 1)));
+  }
+
+ private:
+  ByteQueue(const ByteQueue& other) = delete;
+  ByteQueue& operator=(const ByteQueue& other) = delete;
+
+  size_t size_;
+  uint8_t* buf_addr_ = nullptr;
+  std::string huge_page_path_;
+  bool created_queue_ = false;
+  std::string queue_name_;
+  std::string huge_page_prefix_;
+};
+
+class ByteQueueProducer : public ByteQueue<ByteQueueProducer> {
+ public:
+  /**
+   * @brief Reserves space for a record with up to `nb_bytes` bytes.
+   *
+   * The record can be written in place and must be published with `Commit()`
+   * before reserving another one.
+   *
+   * @param nb_bytes Maximum number of bytes in the record.
+   * @return A pointer to where the record should be written or nullptr if
+   *         there is not enough space in the queue.
+   */
+  inline uint8_t* Reserve(uint32_t nb_bytes) {
+    uint64_t size = record_size(nb_bytes);
+    if (unlikely(tail_ + size > free_end_)) {
+      ReclaimReleased();
+      if (tail_ + size > free_end_) {
+        return nullptr;  // Queue is full.
+      }
+    }
+    reserved_bytes_ = nb_bytes;
+    return reinterpret_cast<uint8_t*>(record_header(tail_) + 1);
+  }
+
+  /**
+   * @brief Publishes the record reserved with `Reserve()`.
+   *
+   * @param nb_bytes Number of bytes in the record. Must be at most the number
+   *        of bytes that were reserved.
+   */
+  inline void Commit(uint32_t nb_bytes) {
+    assert(nb_bytes <= reserved_bytes_);
+    struct RecordHeader* header = record_header(tail_);
+    uint64_t next_tail = tail_ + record_size(nb_bytes);
+
+    header->nb_bytes = nb_bytes;
+
+    // Whatever was in the buffer where the next record will start may look
+    // like a ready record to the consumer. We can only write there if it was
+    // already released, otherwise it is the header of an older record that the
+    // consumer has not released yet.
+    if (next_tail < free_end_) {
+      record_header(next_tail)->state = kRecordEmpty;
+    }
+
+    _enso_compiler_memory_barrier();
+    header->state = kRecordReady;
+
+    tail_ = next_tail;
+    reserved_bytes_ = 0;
+  }
+
+  /**
+   * @brief Copies a record to the queue.
+   *
+   * @param data Data to push.
+   * @param nb_bytes Number of bytes in `data`.
+   * @return 0 on success and a non-zero error code on failure.
+   */
+  inline int Push(const void* data, uint32_t nb_bytes) {
+    uint8_t* record = Reserve(nb_bytes);
+    if (unlikely(record == nullptr)) {
+      return -1;
+    }
+    memcpy(record, data, nb_bytes);
+    Commit(nb_bytes);
+    return 0;
+  }
+
+ protected:
+  explicit ByteQueueProducer(const std::string& queue_name, size_t size,
+                             const std::string& huge_page_prefix) noexcept
+      : ByteQueue<ByteQueueProducer>(queue_name, size, huge_page_prefix) {}
+
+  int Init(bool join_if_exists) noexcept {
+    if (Parent::Init(join_if_exists)) {
+      return -1;
+    }
+    free_end_ = Parent::size();
+    return 0;
+  }
+
+ private:
+  using Parent = ByteQueue<ByteQueueProducer>;
+  friend Parent;
+
+  /**
+   * @brief Advances `free_end_` past the records that the consumer released.
+   *
+   * The consumer releases records in order, so we walk the headers of the
+   * records we pushed, starting from the oldest one.
+   */
+  void ReclaimReleased() {
+    _enso_compiler_memory_barrier();
+    while (reclaim_pos_ < tail_) {
+      struct RecordHeader* header = record_header(reclaim_pos_);
+      if (header->state != kRecordReleased) {
+        break;
+      }
+      reclaim_pos_ += record_size(header->nb_bytes);
+    }
+    free_end_ = reclaim_pos_ + Parent::size();
+  }
+
+  uint64_t tail_ = 0;
+  uint64_t free_end_ = 0;     // Records may be written up to this position.
+  uint64_t reclaim_pos_ = 0;  // Oldest record that was not released.
+  uint32_t reserved_bytes_ = 0;
+};
+
+class ByteQueueConsumer : public ByteQueue<ByteQueueConsumer> {
+ public:
+  /**
+   * @brief Returns the record at the front of the queue without popping it.
+   *
+   * @param nb_bytes Set to the number of bytes in the record.
+   * @return A pointer to the record or nullptr if the queue is empty.
+   */
+  inline uint8_t* Peek(uint32_t* nb_bytes) {
+    _enso_compiler_memory_barrier();
+    struct RecordHeader* header = record_header(head_);
+    if (header->state != kRecordReady) {
+      return nullptr;  // Queue is empty.
+    }
+    _enso_compiler_memory_barrier();
+    *nb_bytes = header->nb_bytes;
+    return reinterpret_cast<uint8_t*>(header + 1);
+  }
+
+  /**
+   * @brief Releases the record at the front of the queue, returned by the
+   *        last call to `Peek()`.
+   *
+   * The record must not be accessed after it is released.
+   */
+  inline void Release() {
+    struct RecordHeader* header = record_header(head_);
+    assert(header->state == kRecordReady);
+    uint64_t size = record_size(header->nb_bytes);
+    _enso_compiler_memory_barrier();
+    header->state = kRecordReleased;
+    head_ += size;
+  }
+
+  /**
+   * @brief Returns if the queue is empty.
+   */
+  inline bool IsEmpty() {
+    uint32_t nb_bytes = 0;
+    return Peek(&nb_bytes) == nullptr;
+  }
+
+ protected:
+  explicit ByteQueueConsumer(const std::string& queue_name, size_t size,
+                             const std::string& huge_page_prefix) noexcept
+      : ByteQueue<ByteQueueConsumer>(queue_name, size, huge_page_prefix) {}
+
+ private:
+  using Parent = ByteQueue<ByteQueueConsumer>;
+  friend Parent;
+
+  uint64_t head_ = 0;
+};
+
 }  // namespace enso
 
 #endif  // ENSO_SOFTWARE_INCLUDE_ENSO_QUEUE_H_
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief SIMD kernels for every supported instruction set and run-time
+ *        selection of the best one for the current CPU.
+ *
+ * The library may be built for a baseline architecture (e.g., with
+ * `-march=x86-64-v3`) so that the same binary runs on CPUs with and without
+ * AVX-512. Code inlined in the fast path uses the instruction set targeted at
+ * compile time and, for operations large enough to pay for a function call,
+ * calls the out-of-line kernels declared here when the CPU supports a better
+ * one. Operations on a single cache line, such as writing a `Queue` element,
+ * always use the compile-time instruction set. When the library is built with
+ * AVX-512 (e.g., with `-march=native` on a CPU that supports it), no run-time
+ * check is done.
+ */
+
+#ifndef ENSO_SOFTWARE_INCLUDE_ENSO_SIMD_H_
+#define ENSO_SOFTWARE_INCLUDE_ENSO_SIMD_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace enso {
+
+/**
+ * @brief Instruction sets with dedicated SIMD kernels, from worst to best.
+ */
+enum class SimdIsa : uint8_t { kSse2 = 0, kAvx2 = 1, kAvx512 = 2 };
+
+/// Instruction set targeted at compile time.
+#if defined(__AVX512F__)
+constexpr SimdIsa kCompiledSimdIsa = SimdIsa::kAvx512;
+#elif defined(__AVX2__)
+constexpr SimdIsa kCompiledSimdIsa = SimdIsa::kAvx2;
+#else
+constexpr SimdIsa kCompiledSimdIsa = SimdIsa::kSse2;
+#endif
+
+// Kernels that need AVX-512 are inlined when the library is built with it,
+// otherwise they are compiled for AVX-512 on their own and called only after
+// checking `simd_isa()`.
+#if defined(__AVX512F__)
+#define _enso_avx512_kernel __attribute__((always_inline)) inline
+#else
+#define _enso_avx512_kernel \
+  __attribute__((target("avx512f,bmi,popcnt"))) inline
+#endif
+
+/**
+ * @brief Returns the best instruction set supported by this CPU (and OS).
+ */
+SimdIsa cpu_simd_isa();
+
+/**
+ * @brief Returns the instruction set that the SIMD kernels should use.
+ */
+inline SimdIsa simd_isa() {
+#if defined(__AVX512F__)
+  return SimdIsa::kAvx512;
+#else
+  static const SimdIsa isa = cpu_simd_isa();
+  return isa;
+#endif
+}
+
+/**
+ * @brief Copies `n` bytes, in multiples of 64 bytes. There is one version for
+ *        every instruction set, the caller must make sure that the CPU
+ *        supports it.
+ *
+ * @param dst 64-byte aligned destination address.
+ * @param src Source address.
+ * @param n 64-byte aligned number of bytes to copy.
+ */
+void memcpy_64_align_sse2(void* dst, const void* src, size_t n);
+void memcpy_64_align_avx2(void* dst, const void* src, size_t n);
+void memcpy_64_align_avx512(void* dst, const void* src, size_t n);
+
+}  // namespace enso
+
+#endif  // ENSO_SOFTWARE_INCLUDE_ENSO_SIMD_H_
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Strategies to wait for memory written by another core or the NIC.
+ *
+ * Busy polling keeps the core at full power and steals execution resources
+ * from its SMT sibling. A `Waiter` starts by polling with `pause` and, as the
+ * wait gets longer, moves to `UMONITOR`/`UMWAIT` on the watched cache line
+ * (when the CPU supports WAITPKG) and, optionally, to parking the thread on a
+ * futex.
+ */
+
+#ifndef ENSO_SOFTWARE_INCLUDE_ENSO_WAIT_H_
+#define ENSO_SOFTWARE_INCLUDE_ENSO_WAIT_H_
+
+#include <enso/helpers.h>
+#include <immintrin.h>
+
+#include <cstdint>
+
+namespace enso {
+
+/**
+ * @brief Configures how a `Waiter` waits.
+ */
+struct WaitStrategy {
+  /// Number of waits that poll with `pause` before waiting on the cache line.
+  uint32_t nb_spins = 256;
+
+  /// Number of waits that use `UMONITOR`/`UMWAIT` before parking. Ignored if
+  /// the CPU does not support WAITPKG.
+  uint32_t nb_monitor_waits = 64;
+
+  /// Maximum number of TSC cycles to sleep in every `UMWAIT`.
+  uint32_t monitor_wait_cycles = 20000;
+
+  /// Whether to park the thread on a futex once the other stages are done.
+  /// Parked threads wake up when `wake_waiters()` is called on the watched
+  /// address or after `park_timeout_us`, whichever comes first.
+  bool park = false;
+
+  /// Maximum time to park the thread in every wait (in microseconds).
+  uint32_t park_timeout_us = 100;
+};
+
+/**
+ * @brief Waits for a 32-bit word in memory to change.
+ *
+ * Call `Wait()` every time a poll finds nothing to do and `Reset()` whenever
+ * it does, so that the waiter goes back to polling.
+ *
+ * Example:
+ * @code
+ *    enso::Waiter waiter;
+ *    while (keep_running) {
+ *      RxPipe* pipe = dev->NextRxPipeToRecv();
+ *      if (pipe == nullptr) {
+ *        dev->WaitForRx(&waiter);
+ *        continue;
+ *      }
+ *      waiter.Reset();
+ *      // ...
+ *    }
+ * @endcode
+ */
+class Waiter {
+ public:
+  explicit Waiter(const WaitStrategy& strategy = WaitStrategy()) noexcept
+      : strategy_(strategy) {}
+
+  /**
+   * @brief Waits while `*addr` is equal to `value`.
+   *
+   * May return before `*addr` changes, callers should check again for the
+   * condition they are waiting for.
+   *
+   * @param addr Address to watch. Anything that writes to its cache line may
+   *             wake the waiter.
+   * @param value Value of `*addr` when there is nothing to do.
+   */
+  inline void Wait(const volatile uint32_t* addr, uint32_t value) {
+    if (likely(nb_waits_ < strategy_.nb_spins)) {
+      ++nb_waits_;
+      _mm_pause();
+      return;
+    }
+    WaitSlow(addr, value);
+  }
+
+  /**
+   * @brief Resets the waiter to the first stage, should be called after the
+   *        condition being waited for is met.
+   */
+  inline void Reset() { nb_waits_ = 0; }
+
+ private:
+  void WaitSlow(const volatile uint32_t* addr, uint32_t value);
+
+  WaitStrategy strategy_;
+  uint32_t nb_waits_ = 0;
+};
+
+/**
+ * @brief Wakes up all the threads parked waiting on `addr`.
+ *
+ * Only needed to cut the wake up latency of waiters that use
+ * `WaitStrategy::park`, as parked threads also wake up periodically.
+ */
+void wake_waiters(const volatile uint32_t* addr);
+
+/**
+ * @brief Returns whether this CPU supports `UMONITOR`/`UMWAIT` (WAITPKG).
+ */
+bool cpu_has_waitpkg();
+
+}  // namespace enso
+
+#endif  // ENSO_SOFTWARE_INCLUDE_ENSO_WAIT_H_
@@ -58,6 +58,12 @@
 #include "enso/queue.h"
 #include "intel_fpga_pcie_api.hpp"
 
+// Register writes must go through this backend, including the ones inlined from
+// `enso/fast_path.h`.
+#ifndef ENSO_INDIRECT_MMIO
+#error "The hybrid backend must be built with ENSO_INDIRECT_MMIO defined."
+#endif  // ENSO_INDIRECT_MMIO
+
 namespace enso {
 
 thread_local std::unique_ptr<QueueProducer<PipeNotification>> queue_to_backend_;
@@ -113,13 +119,8 @@ std::optional<PipeNotification> push_to_backend_get_response(
     PipeNotification* notif) {
   while (queue_to_backend_->Push(*notif) != 0) {
   }
-  std::optional<PipeNotification> notification;
-
   // Block until receive.
-  while (!(notification = queue_from_backend_->Pop())) {
-  }
-
-  return notification;
+  return queue_from_backend_->PopBlocking();
 }
 class DevBackend {
  public:
@@ -243,6 +244,27 @@ class DevBackend {
     return virt_to_phys(virt_addr);
   }
 
+  /**
+   * Whether device addresses are the application's virtual addresses. The
+   * device uses physical addresses, so buffers shared with it must be backed
+   * by huge pages.
+   */
+  static constexpr bool kDevAddrIsVirtAddr = false;
+
+  /**
+   * @brief Converts multiple addresses in the application's virtual address
+   *        space to addresses that can be used by the device.
+   * @param virt_addr First address to convert.
+   * @param stride Distance in bytes between the addresses to convert.
+   * @param nb_addrs Number of addresses to convert.
+   * @param dev_addrs Array where the converted addresses will be stored.
+   * @return 0 on success, -1 if any of the addresses cannot be translated.
+   */
+  int ConvertVirtAddrsToDevAddrs(void* virt_addr, size_t stride,
+                                 uint32_t nb_addrs, uint64_t* dev_addrs) {
+    return virt_to_phys_batch(virt_addr, stride, nb_addrs, dev_addrs);
+  }
+
   /**
    * @brief Retrieves the number of fallback queues currently in use.
    * @return The number of fallback queues currently in use. On error, -1 is
@@ -389,6 +411,22 @@ class DevBackend {
    */
   int FreePipe(int pipe_id) { return dev_->free_pipe(pipe_id); }
 
+  /**
+   * @brief Sets the size of a pipe. Must be called before the pipe is enabled.
+   *
+   * The hardware uses the same size for all pipes, which is configured
+   * together with the rest of the device. Therefore, only `kEnsoPipeSize` is
+   * supported.
+   *
+   * @param pipe_id Pipe ID.
+   * @param nb_flits Size of the pipe in flits.
+   *
+   * @return 0 on success. On error, -1 is returned.
+   */
+  int SetPipeSize([[maybe_unused]] int pipe_id, uint32_t nb_flits) {
+    return nb_flits == kEnsoPipeSize ? 0 : -1;
+  }
+
  private:
   explicit DevBackend(unsigned int bdf, int bar) noexcept
       : bdf_(bdf), bar_(bar) {}
@@ -42,6 +42,8 @@
 
 #include <enso/helpers.h>
 
+#include <optional>
+
 #include "intel_fpga_pcie_api.hpp"
 
 namespace enso {
@@ -123,6 +125,27 @@ class DevBackend {
     return virt_to_phys(virt_addr);
   }
 
+  /**
+   * Whether device addresses are the application's virtual addresses. The
+   * device uses physical addresses, so buffers shared with it must be backed
+   * by huge pages.
+   */
+  static constexpr bool kDevAddrIsVirtAddr = false;
+
+  /**
+   * @brief Converts multiple addresses in the application's virtual address
+   *        space to addresses that can be used by the device.
+   * @param virt_addr First address to convert.
+   * @param stride Distance in bytes between the addresses to convert.
+   * @param nb_addrs Number of addresses to convert.
+   * @param dev_addrs Array where the converted addresses will be stored.
+   * @return 0 on success, -1 if any of the addresses cannot be translated.
+   */
+  int ConvertVirtAddrsToDevAddrs(void* virt_addr, size_t stride,
+                                 uint32_t nb_addrs, uint64_t* dev_addrs) {
+    return virt_to_phys_batch(virt_addr, stride, nb_addrs, dev_addrs);
+  }
+
   /**
    * @brief Retrieves the number of fallback queues currently in use.
    * @return The number of fallback queues currently in use. On error, -1 is
@@ -188,6 +211,22 @@ class DevBackend {
    */
   int FreePipe(int pipe_id) { return dev_->free_pipe(pipe_id); }
 
+  /**
+   * @brief Sets the size of a pipe. Must be called before the pipe is enabled.
+   *
+   * The hardware uses the same size for all pipes, which is configured
+   * together with the rest of the device. Therefore, only `kEnsoPipeSize` is
+   * supported.
+   *
+   * @param pipe_id Pipe ID.
+   * @param nb_flits Size of the pipe in flits.
+   *
+   * @return 0 on success. On error, -1 is returned.
+   */
+  int SetPipeSize([[maybe_unused]] int pipe_id, uint32_t nb_flits) {
+    return nb_flits == kEnsoPipeSize ? 0 : -1;
+  }
+
  private:
   explicit DevBackend(unsigned int bdf, int bar) noexcept
       : bdf_(bdf), bar_(bar) {}
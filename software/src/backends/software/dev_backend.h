@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Device backend wrapper for the software NIC emulator.
+ *
+ * Allows Enso to run on machines without the NIC. See `software_nic.h` for a
+ * description of the emulated NIC.
+ */
+
+#ifndef ENSO_SOFTWARE_SRC_BACKENDS_SOFTWARE_DEV_BACKEND_H_
+#define ENSO_SOFTWARE_SRC_BACKENDS_SOFTWARE_DEV_BACKEND_H_
+
+#include <enso/consts.h>
+#include <enso/helpers.h>
+#include <enso/internals.h>
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <optional>
+
+#include "software_nic.h"
+
+namespace enso {
+
+int initialize_queues(uint32_t id) {
+  (void)id;
+  return 0;
+}
+
+void initialize_backend_dev(CounterCallback counter_callback,
+                            uint32_t application_id) {
+  (void)counter_callback;
+  (void)application_id;
+}
+
+void push_to_backend(enso::PipeNotification* notif) { (void)notif; }
+
+void update_backend_queues() {}
+
+void access_backend_queues() {}
+
+std::optional<PipeNotification> push_to_backend_get_response(
+    enso::PipeNotification* notif) {
+  (void)notif;
+  std::optional<PipeNotification> res;
+  return res;
+}
+
+class DevBackend {
+ public:
+  static DevBackend* Create(unsigned int bdf, int bar) noexcept {
+    DevBackend* dev = new (std::nothrow) DevBackend(bdf, bar);
+
+    if (dev == nullptr) {
+      return nullptr;
+    }
+
+    if (dev->Init()) {
+      delete dev;
+      return nullptr;
+    }
+
+    return dev;
+  }
+
+  ~DevBackend() noexcept {
+    if (nic_ != nullptr) {
+      SoftwareNic::Release();
+    }
+  }
+
+  void* uio_mmap(size_t size, unsigned int mapping) {
+    if (mapping != 2 || size > SoftwareNic::kBar2Size) {
+      return MAP_FAILED;
+    }
+    return nic_->bar2_addr();
+  }
+
+  static _enso_always_inline void mmio_write32(volatile uint32_t* addr,
+                                               uint32_t value,
+                                               void* uio_mmap_bar2_addr) {
+    _enso_compiler_memory_barrier();
+    *addr = value;
+
+    // Writes to the address registers may enable or disable a queue and must
+    // be forwarded to the emulator. They are the only registers at an offset
+    // with bit 3 set.
+    uint64_t offset = (uint64_t)addr - (uint64_t)uio_mmap_bar2_addr;
+    uint32_t reg_offset = offset % kMemorySpacePerQueue;
+    if (unlikely((reg_offset & kAddrRegBit) &&
+                 reg_offset < offsetof(struct QueueRegs, padding))) {
+      SoftwareNic::OnAddrRegWrite(offset, value);
+    }
+  }
+
+  static _enso_always_inline uint32_t mmio_read32(volatile uint32_t* addr,
+                                                  void* uio_mmap_bar2_addr) {
+    (void)uio_mmap_bar2_addr;
+    _enso_compiler_memory_barrier();
+    return *addr;
+  }
+
+  /**
+   * @brief Converts an address in the application's virtual address space to an
+   *        address that can be used by the device. The emulated NIC shares the
+   *        application's address space, so this is the identity.
+   * @param virt_addr Address in the application's virtual address space.
+   * @return Address that can be used by the device.
+   */
+  uint64_t ConvertVirtAddrToDevAddr(void* virt_addr) {
+    return (uint64_t)virt_addr;
+  }
+
+  /**
+   * Whether device addresses are the application's virtual addresses. If so,
+   * buffers shared with the device do not need to be physically contiguous.
+   */
+  static constexpr bool kDevAddrIsVirtAddr = true;
+
+  /**
+   * @brief Converts multiple addresses in the application's virtual address
+   *        space to addresses that can be used by the device.
+   * @param virt_addr First address to convert.
+   * @param stride Distance in bytes between the addresses to convert.
+   * @param nb_addrs Number of addresses to convert.
+   * @param dev_addrs Array where the converted addresses will be stored.
+   * @return 0 on success, -1 if any of the addresses cannot be translated.
+   */
+  int ConvertVirtAddrsToDevAddrs(void* virt_addr, size_t stride,
+                                 uint32_t nb_addrs, uint64_t* dev_addrs) {
+    for (uint32_t i = 0; i < nb_addrs; ++i) {
+      dev_addrs[i] = (uint64_t)virt_addr + i * stride;
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Retrieves the number of fallback queues currently in use.
+   * @return The number of fallback queues currently in use. On error, -1 is
+   *         returned.
+   */
+  int GetNbFallbackQueues() { return nic_->GetNbFallbackQueues(); }
+
+  /**
+   * @brief Sets the Round-Robin status.
+   *
+   * @param enable_rr If true, enable RR. Otherwise, disable RR.
+   *
+   * @return Return 0 on success. On error, -1 is returned.
+   */
+  int SetRrStatus(bool round_robin) { return nic_->SetRrStatus(round_robin); }
+
+  /**
+   * @brief Gets the Round-Robin status.
+   *
+   * @return Return 1 if RR is enabled. Otherwise, return 0. On error, -1 is
+   *         returned.
+   */
+  int GetRrStatus() { return nic_->GetRrStatus(); }
+
+  /**
+   * @brief Allocates a notification buffer.
+   *
+   * @return Notification buffer ID. On error, -1 is returned.
+   */
+  int AllocateNotifBuf(int32_t uthread_id) {
+    (void)uthread_id;
+    return nic_->AllocateNotifBuf();
+  }
+
+  /**
+   * @brief Frees a notification buffer.
+   *
+   * @param notif_buf_id Notification buffer ID.
+   *
+   * @return Return 0 on success. On error, -1 is returned.
+   */
+  int FreeNotifBuf(int notif_buf_id) {
+    return nic_->FreeNotifBuf(notif_buf_id);
+  }
+
+  /**
+   * @brief Allocates a pipe.
+   *
+   * @param fallback If true, allocates a fallback pipe. Otherwise, allocates a
+   *                regular pipe.
+   * @return Pipe ID. On error, -1 is returned.
+   */
+  int AllocatePipe(bool fallback = false) {
+    return nic_->AllocatePipe(fallback);
+  }
+
+  /**
+   * @brief Frees a pipe.
+   *
+   * @param pipe_id Pipe ID to be freed.
+   *
+   * @return 0 on success. On error, -1 is returned.
+   */
+  int FreePipe(int pipe_id) { return nic_->FreePipe(pipe_id); }
+
+  /**
+   * @brief Sets the size of a pipe. Must be called before the pipe is enabled.
+   *
+   * The emulated NIC supports any pipe size.
+   *
+   * @param pipe_id Pipe ID.
+   * @param nb_flits Size of the pipe in flits.
+   *
+   * @return 0 on success. On error, -1 is returned.
+   */
+  int SetPipeSize(int pipe_id, uint32_t nb_flits) {
+    return nic_->SetPipeSize(pipe_id, nb_flits);
+  }
+
+ private:
+  static constexpr uint32_t kAddrRegBit = 0x8;
+  static_assert(offsetof(struct QueueRegs, rx_mem_low) & kAddrRegBit);
+  static_assert(offsetof(struct QueueRegs, rx_mem_high) & kAddrRegBit);
+  static_assert(offsetof(struct QueueRegs, tx_mem_low) & kAddrRegBit);
+  static_assert(offsetof(struct QueueRegs, tx_mem_high) & kAddrRegBit);
+  static_assert(!(offsetof(struct QueueRegs, rx_tail) & kAddrRegBit));
+  static_assert(!(offsetof(struct QueueRegs, rx_head) & kAddrRegBit));
+  static_assert(!(offsetof(struct QueueRegs, tx_tail) & kAddrRegBit));
+  static_assert(!(offsetof(struct QueueRegs, tx_head) & kAddrRegBit));
+
+  explicit DevBackend(unsigned int bdf, int bar) noexcept
+      : bdf_(bdf), bar_(bar) {}
+
+  DevBackend(const DevBackend& other) = delete;
+  DevBackend& operator=(const DevBackend& other) = delete;
+  DevBackend(DevBackend&& other) = delete;
+  DevBackend& operator=(DevBackend&& other) = delete;
+
+  int Init() noexcept {
+    nic_ = SoftwareNic::Acquire();
+    if (nic_ == nullptr) {
+      return -1;
+    }
+    return 0;
+  }
+
+  SoftwareNic* nic_ = nullptr;
+  unsigned int bdf_;
+  int bar_;
+};
+
+}  // namespace enso
+
+#endif  // ENSO_SOFTWARE_SRC_BACKENDS_SOFTWARE_DEV_BACKEND_H_
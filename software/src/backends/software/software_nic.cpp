@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Software emulation of the Enso NIC.
+ */
+
+#include "software_nic.h"
+
+#include <enso/helpers.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace enso {
+
+// Configuration notifications, as understood by the NIC. These must match the
+// definitions in `src/enso/config.cpp`.
+enum ConfigId { FLOW_TABLE_CONFIG_ID = 1, FALLBACK_QUEUES_CONFIG_ID = 4 };
+
+struct __attribute__((__packed__)) FlowTableConfig {
+  uint64_t signal;
+  uint64_t config_id;
+  uint16_t dst_port;
+  uint16_t src_port;
+  uint32_t dst_ip;
+  uint32_t src_ip;
+  uint32_t protocol;
+  uint32_t enso_pipe_id;
+  uint8_t pad[28];
+};
+
+struct __attribute__((__packed__)) FallbackQueueConfig {
+  uint64_t signal;
+  uint64_t config_id;
+  uint32_t nb_fallback_queues;
+  uint32_t fallback_queue_mask;
+  uint64_t enable_rr;
+  uint8_t pad[32];
+};
+
+constexpr uint32_t kMinPktSize = 64;
+constexpr uint32_t kMaxPktSize = 9216;
+
+static _enso_always_inline uint32_t read_reg(const uint32_t* reg) {
+  return *(const volatile uint32_t*)reg;
+}
+
+static _enso_always_inline void write_reg(uint32_t* reg, uint32_t value) {
+  _enso_compiler_memory_barrier();
+  *(volatile uint32_t*)reg = value;
+}
+
+static uint32_t get_env_u32(const char* name, uint32_t default_value) {
+  const char* str = std::getenv(name);
+  if (str == nullptr) {
+    return default_value;
+  }
+  return (uint32_t)std::strtoul(str, nullptr, 10);
+}
+
+SoftwareNic* SoftwareNic::instance_ = nullptr;
+std::mutex SoftwareNic::instance_mutex_;
+uint32_t SoftwareNic::ref_cnt_ = 0;
+
+SoftwareNic* SoftwareNic::Acquire() noexcept {
+  std::lock_guard<std::mutex> lock(instance_mutex_);
+  if (ref_cnt_ == 0) {
+    SoftwareNic* nic = new (std::nothrow) SoftwareNic();
+    if (nic == nullptr) {
+      return nullptr;
+    }
+    if (nic->Init()) {
+      delete nic;
+      return nullptr;
+    }
+    instance_ = nic;
+  }
+  ++ref_cnt_;
+  return instance_;
+}
+
+void SoftwareNic::Release() noexcept {
+  std::lock_guard<std::mutex> lock(instance_mutex_);
+  if (ref_cnt_ == 0) {
+    return;
+  }
+  if (--ref_cnt_ == 0) {
+    delete instance_;
+    instance_ = nullptr;
+  }
+}
+
+void SoftwareNic::OnAddrRegWrite(uint64_t offset, uint32_t value) noexcept {
+  // Holding the lock also keeps `Release()` from deleting the instance while
+  // we use it.
+  std::lock_guard<std::mutex> lock(instance_mutex_);
+  if (instance_ == nullptr || offset >= kBar2Size) {
+    return;
+  }
+  instance_->SetQueueState(offset, value);
+}
+
+int SoftwareNic::Init() noexcept {
+  bar2_addr_ = mmap(nullptr, kBar2Size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (bar2_addr_ == MAP_FAILED) {
+    bar2_addr_ = nullptr;
+    std::cerr << "Could not allocate memory for the emulated BAR"
+              << std::endl;
+    return -1;
+  }
+
+  pipe_allocated_.assign(kMaxNbFlows, false);
+  pipe_enabled_.assign(kMaxNbFlows, false);
+  pipe_sizes_.assign(kMaxNbFlows, kEnsoPipeSize);
+  notif_buf_allocated_.assign(kMaxNbApps, false);
+  notif_buf_enabled_.assign(kMaxNbApps, false);
+  pipes_.assign(kMaxNbFlows, EmuPipe{});
+  notif_bufs_.assign(kMaxNbApps, EmuNotifBuf{});
+
+  pkt_size_ = get_env_u32("ENSO_SW_NIC_PKT_SIZE", pkt_size_);
+  if (pkt_size_ != 0) {
+    pkt_size_ = std::clamp(pkt_size_, kMinPktSize, kMaxPktSize);
+  }
+  burst_size_ = std::max(get_env_u32("ENSO_SW_NIC_BURST", burst_size_), 1U);
+  core_id_ = (int)get_env_u32("ENSO_SW_NIC_CORE", (uint32_t)core_id_);
+
+  BuildPacket(&fallback_pkt_, 0, 0, 0, 0, IPPROTO_UDP);
+
+  running_ = true;
+  thread_ = std::thread(&SoftwareNic::Run, this);
+  if (core_id_ >= 0 && set_core_id(thread_, core_id_)) {
+    std::cerr << "Could not pin emulator thread to core " << core_id_
+              << std::endl;
+  }
+
+  return 0;
+}
+
+SoftwareNic::~SoftwareNic() noexcept {
+  if (thread_.joinable()) {
+    running_ = false;
+    thread_.join();
+  }
+  if (bar2_addr_ != nullptr) {
+    munmap(bar2_addr_, kBar2Size);
+  }
+}
+
+int SoftwareNic::AllocateNotifBuf() noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint32_t i = 0; i < kMaxNbApps; ++i) {
+    if (!notif_buf_allocated_[i]) {
+      notif_buf_allocated_[i] = true;
+      return i;
+    }
+  }
+  return -1;
+}
+
+int SoftwareNic::FreeNotifBuf(int notif_buf_id) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (notif_buf_id < 0 || (uint32_t)notif_buf_id >= kMaxNbApps ||
+      !notif_buf_allocated_[notif_buf_id]) {
+    return -1;
+  }
+  notif_buf_allocated_[notif_buf_id] = false;
+  return 0;
+}
+
+// Same policy as the kernel driver: fallback pipes are allocated contiguously
+// from the beginning of the ID space, so that they can be selected with a
+// mask, while regular pipes are allocated from the end.
+int SoftwareNic::AllocatePipe(bool fallback) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fallback) {
+    uint32_t id = nb_fallback_pipes_;
+    if (id >= kMaxNbFlows || pipe_allocated_[id]) {
+      return -1;
+    }
+    pipe_allocated_[id] = true;
+    ++nb_fallback_pipes_;
+    return id;
+  }
+
+  for (int32_t id = kMaxNbFlows - 1; id >= (int32_t)nb_fallback_pipes_;
+       --id) {
+    if (!pipe_allocated_[id]) {
+      pipe_allocated_[id] = true;
+      return id;
+    }
+  }
+  return -1;
+}
+
+int SoftwareNic::FreePipe(int pipe_id) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pipe_id < 0 || (uint32_t)pipe_id >= kMaxNbFlows ||
+      !pipe_allocated_[pipe_id]) {
+    return -1;
+  }
+  pipe_allocated_[pipe_id] = false;
+  if ((uint32_t)pipe_id < nb_fallback_pipes_) {
+    --nb_fallback_pipes_;
+  }
+  return 0;
+}
+
+int SoftwareNic::SetPipeSize(int pipe_id, uint32_t nb_flits) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pipe_id < 0 || (uint32_t)pipe_id >= kMaxNbFlows ||
+      !pipe_allocated_[pipe_id] || pipe_enabled_[pipe_id]) {
+    return -1;
+  }
+  // The emulator picks up the size when the pipe is enabled.
+  pipe_sizes_[pipe_id] = nb_flits;
+  return 0;
+}
+
+int SoftwareNic::GetNbFallbackQueues() noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nb_fallback_pipes_;
+}
+
+int SoftwareNic::SetRrStatus(bool enable_rr) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rr_status_ = enable_rr;
+  return 0;
+}
+
+int SoftwareNic::GetRrStatus() noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rr_status_;
+}
+
+void SoftwareNic::SetQueueState(uint64_t offset, uint32_t value) noexcept {
+  uint32_t queue_id = offset / kMemorySpacePerQueue;
+  uint32_t reg = offset % kMemorySpacePerQueue;
+  struct QueueRegs* regs =
+      (struct QueueRegs*)((uint8_t*)bar2_addr_ +
+                          (uint64_t)queue_id * kMemorySpacePerQueue);
+  uint64_t rx_addr =
+      ((uint64_t)read_reg(&regs->rx_mem_high) << 32) |
+      read_reg(&regs->rx_mem_low);
+
+  // Queues are disabled by clearing `rx_mem_low` and enabled by writing the
+  // last address register in the initialization sequence.
+  bool enable;
+  if (reg == offsetof(struct QueueRegs, rx_mem_low) && value == 0) {
+    enable = false;
+  } else if (queue_id < kMaxNbFlows &&
+             reg == offsetof(struct QueueRegs, rx_mem_high)) {
+    enable = rx_addr != 0;
+  } else if (queue_id >= kMaxNbFlows &&
+             reg == offsetof(struct QueueRegs, tx_mem_high)) {
+    enable = rx_addr != 0;
+  } else {
+    return;
+  }
+
+  uint64_t version;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<bool>& enabled =
+        queue_id < kMaxNbFlows ? pipe_enabled_ : notif_buf_enabled_;
+    uint32_t id = queue_id < kMaxNbFlows ? queue_id : queue_id - kMaxNbFlows;
+    if (enabled[id] == enable) {
+      return;
+    }
+    enabled[id] = enable;
+    version = ++requested_version_;
+  }
+
+  // Wait for the emulator to pick up the change.
+  while (applied_version_.load(std::memory_order_acquire) < version) {
+    std::this_thread::yield();
+  }
+}
+
+void SoftwareNic::SyncQueues() noexcept {
+  uint64_t version = requested_version_.load(std::memory_order_acquire);
+  if (likely(version == applied_version_.load(std::memory_order_relaxed))) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  version = requested_version_.load(std::memory_order_relaxed);
+
+  for (uint32_t id = 0; id < kMaxNbFlows; ++id) {
+    EmuPipe& pipe = pipes_[id];
+    if (pipe_enabled_[id] == pipe.active) {
+      continue;
+    }
+    pipe.active = pipe_enabled_[id];
+    if (!pipe.active) {
+      continue;
+    }
+    pipe.regs = (struct QueueRegs*)((uint8_t*)bar2_addr_ +
+                                    (uint64_t)id * kMemorySpacePerQueue);
+    uint64_t addr = ((uint64_t)read_reg(&pipe.regs->rx_mem_high) << 32) |
+                    read_reg(&pipe.regs->rx_mem_low);
+
+    // The least significant bits carry the notification buffer ID.
+    pipe.notif_buf_id = addr & (kMaxNbApps - 1);
+    pipe.buf = (uint8_t*)(addr & ~((uint64_t)kMaxNbApps - 1));
+    pipe.tail = read_reg(&pipe.regs->rx_tail);
+    pipe.mask = pipe_sizes_[id] - 1;
+  }
+
+  active_notif_bufs_.clear();
+  for (uint32_t id = 0; id < kMaxNbApps; ++id) {
+    EmuNotifBuf& notif_buf = notif_bufs_[id];
+    if (notif_buf_enabled_[id] != notif_buf.active) {
+      notif_buf.active = notif_buf_enabled_[id];
+      if (notif_buf.active) {
+        notif_buf.regs =
+            (struct QueueRegs*)((uint8_t*)bar2_addr_ +
+                                (uint64_t)(id + kMaxNbFlows) *
+                                    kMemorySpacePerQueue);
+        struct QueueRegs* regs = notif_buf.regs;
+        notif_buf.rx_buf = (struct RxNotification*)(
+            ((uint64_t)read_reg(&regs->rx_mem_high) << 32) |
+            read_reg(&regs->rx_mem_low));
+        notif_buf.tx_buf = (struct TxNotification*)(
+            ((uint64_t)read_reg(&regs->tx_mem_high) << 32) |
+            read_reg(&regs->tx_mem_low));
+        notif_buf.rx_tail = read_reg(&regs->rx_tail);
+        notif_buf.tx_head = read_reg(&regs->tx_head);
+      }
+    }
+    if (notif_buf.active) {
+      active_notif_bufs_.push_back(id);
+    }
+  }
+
+  applied_version_.store(version, std::memory_order_release);
+}
+
+void SoftwareNic::Run() noexcept {
+  while (running_.load(std::memory_order_relaxed)) {
+    SyncQueues();
+
+    uint32_t work = 0;
+    for (uint32_t id : active_notif_bufs_) {
+      work += ProcessTx(&notif_bufs_[id]);
+    }
+    work += GeneratePackets();
+
+    if (work == 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+uint32_t SoftwareNic::ProcessTx(EmuNotifBuf* notif_buf) noexcept {
+  uint32_t tail = read_reg(&notif_buf->regs->tx_tail) % kNotificationBufSize;
+  uint32_t head = notif_buf->tx_head;
+  uint32_t nb_processed = 0;
+
+  while (head != tail) {
+    volatile struct TxNotification* notif = notif_buf->tx_buf + head;
+    uint64_t signal = notif->signal;
+    if (signal == 0) {
+      break;
+    }
+
+    // Data is not sent anywhere, TX is simply acknowledged.
+    if (signal >= 2) {
+      ApplyConfig((struct TxNotification*)notif);
+    }
+
+    _enso_compiler_memory_barrier();
+    notif->signal = 0;
+
+    head = (head + 1) % kNotificationBufSize;
+    ++nb_processed;
+  }
+
+  if (nb_processed != 0) {
+    notif_buf->tx_head = head;
+    write_reg(&notif_buf->regs->tx_head, head);
+  }
+
+  return nb_processed;
+}
+
+void SoftwareNic::ApplyConfig(const struct TxNotification* config) noexcept {
+  const uint64_t config_id = ((const uint64_t*)config)[1];
+
+  if (config_id == FLOW_TABLE_CONFIG_ID) {
+    const struct FlowTableConfig* flow_config =
+        (const struct FlowTableConfig*)config;
+    for (FlowEntry& flow : flows_) {
+      if (flow.dst_port == flow_config->dst_port &&
+          flow.src_port == flow_config->src_port &&
+          flow.dst_ip == flow_config->dst_ip &&
+          flow.src_ip == flow_config->src_ip &&
+          flow.protocol == flow_config->protocol) {
+        flow.pipe_id = flow_config->enso_pipe_id;
+        return;
+      }
+    }
+    FlowEntry flow;
+    flow.dst_port = flow_config->dst_port;
+    flow.src_port = flow_config->src_port;
+    flow.dst_ip = flow_config->dst_ip;
+    flow.src_ip = flow_config->src_ip;
+    flow.protocol = flow_config->protocol;
+    flow.pipe_id = flow_config->enso_pipe_id;
+    BuildPacket(&flow.pkt, flow.dst_ip, flow.src_ip, flow.dst_port,
+                flow.src_port, flow.protocol);
+    flows_.push_back(std::move(flow));
+  } else if (config_id == FALLBACK_QUEUES_CONFIG_ID) {
+    const struct FallbackQueueConfig* fallback_config =
+        (const struct FallbackQueueConfig*)config;
+    fallback_nb_queues_ = fallback_config->nb_fallback_queues;
+    fallback_mask_ = fallback_config->fallback_queue_mask;
+    fallback_rr_ = fallback_config->enable_rr;
+  }
+  // Other configurations (e.g., timestamp, rate limit) have no effect on the
+  // emulated NIC.
+}
+
+uint32_t SoftwareNic::DeliverBurst(enso_pipe_id_t pipe_id,
+                                   const uint8_t* pkt) noexcept {
+  EmuPipe& pipe = pipes_[pipe_id];
+  if (!pipe.active) {
+    return 0;
+  }
+  EmuNotifBuf& notif_buf = notif_bufs_[pipe.notif_buf_id];
+  if (!notif_buf.active) {
+    return 0;
+  }
+
+  uint32_t free_notif_slots =
+      (read_reg(&notif_buf.regs->rx_head) - notif_buf.rx_tail - 1) %
+      kNotificationBufSize;
+  if (free_notif_slots == 0) {
+    return 0;
+  }
+
+  uint32_t flits_per_pkt = (pkt_size_ + 63) / 64;
+  uint32_t free_flits =
+      (read_reg(&pipe.regs->rx_head) - pipe.tail - 1) & pipe.mask;
+  uint32_t nb_pkts = std::min(burst_size_, free_flits / flits_per_pkt);
+  if (nb_pkts == 0) {
+    return 0;
+  }
+
+  // Pipe buffers are mapped twice in sequence, we can therefore write past the
+  // end of the buffer without worrying about wrapping around.
+  uint8_t* dst = pipe.buf + (uint64_t)pipe.tail * 64;
+  for (uint32_t i = 0; i < nb_pkts; ++i) {
+    memcpy(dst, pkt, flits_per_pkt * 64);
+    dst += flits_per_pkt * 64;
+  }
+  pipe.tail = (pipe.tail + nb_pkts * flits_per_pkt) & pipe.mask;
+
+  volatile struct RxNotification* notif =
+      notif_buf.rx_buf + notif_buf.rx_tail;
+  notif->queue_id = pipe_id;
+  notif->tail = pipe.tail;
+  _enso_compiler_memory_barrier();
+  notif->signal = 1;
+  notif_buf.rx_tail = (notif_buf.rx_tail + 1) % kNotificationBufSize;
+
+  return nb_pkts;
+}
+
+uint32_t SoftwareNic::GeneratePackets() noexcept {
+  if (pkt_size_ == 0) {
+    return 0;
+  }
+
+  uint32_t nb_pkts = 0;
+  if (!flows_.empty()) {
+    for (const FlowEntry& flow : flows_) {
+      nb_pkts += DeliverBurst(flow.pipe_id, flow.pkt.data());
+    }
+  } else if (fallback_nb_queues_ != 0) {
+    // Packets that do not match any flow go to the fallback pipes.
+    uint32_t pipe_id = fallback_rr_ ? fallback_cnt_ % fallback_nb_queues_
+                                    : fallback_cnt_ & fallback_mask_;
+    ++fallback_cnt_;
+    nb_pkts += DeliverBurst(pipe_id, fallback_pkt_.data());
+  }
+  return nb_pkts;
+}
+
+void SoftwareNic::BuildPacket(std::vector<uint8_t>* pkt, uint32_t dst_ip,
+                              uint32_t src_ip, uint16_t dst_port,
+                              uint16_t src_port,
+                              uint32_t protocol) const noexcept {
+  uint32_t flits_per_pkt = (std::max(pkt_size_, kMinPktSize) + 63) / 64;
+  pkt->assign(flits_per_pkt * 64, 0);
+
+  struct ether_header* l2_hdr = (struct ether_header*)pkt->data();
+  l2_hdr->ether_type = htons(ETHERTYPE_IP);
+
+  struct iphdr* l3_hdr = (struct iphdr*)(l2_hdr + 1);
+  l3_hdr->version = 4;
+  l3_hdr->ihl = 5;
+  l3_hdr->tot_len =
+      htons(std::max(pkt_size_, kMinPktSize) - sizeof(struct ether_header));
+  l3_hdr->ttl = 64;
+  l3_hdr->protocol = protocol;
+  l3_hdr->saddr = htonl(src_ip);
+  l3_hdr->daddr = htonl(dst_ip);
+
+  // TCP and UDP both start with the source and destination ports.
+  uint16_t* l4_ports = (uint16_t*)(l3_hdr + 1);
+  l4_ports[0] = htons(src_port);
+  l4_ports[1] = htons(dst_port);
+}
+
+}  // namespace enso
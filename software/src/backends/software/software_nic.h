@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Software emulation of the Enso NIC.
+ *
+ * The emulator owns an in-memory replica of BAR 2 (the queue registers) and
+ * runs a thread that plays the role of the hardware: it consumes TX
+ * notifications, applies configuration notifications, and synthesizes packets
+ * that are written to the enabled pipes, posting RX notifications just like
+ * the NIC would. This allows the library to be exercised and benchmarked on
+ * machines without an FPGA.
+ */
+
+#ifndef ENSO_SOFTWARE_SRC_BACKENDS_SOFTWARE_SOFTWARE_NIC_H_
+#define ENSO_SOFTWARE_SRC_BACKENDS_SOFTWARE_SOFTWARE_NIC_H_
+
+#include <enso/consts.h>
+#include <enso/internals.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace enso {
+
+/**
+ * @brief Software replica of the NIC.
+ *
+ * There is a single emulated NIC per process. It is reference counted so that
+ * every `DevBackend` shares the same register space and pipe/notification
+ * buffer IDs, mirroring what happens with a real device.
+ *
+ * The emulated NIC may be tuned with the following environment variables:
+ * - `ENSO_SW_NIC_PKT_SIZE`: Size of the synthesized packets in bytes (default:
+ *   64). Setting it to 0 disables packet generation.
+ * - `ENSO_SW_NIC_BURST`: Maximum number of packets written to a pipe before
+ *   posting a notification (default: 16).
+ * - `ENSO_SW_NIC_CORE`: Core to pin the emulator thread to (default: none).
+ */
+class SoftwareNic {
+ public:
+  /**
+   * @brief Gets a reference to the emulated NIC, starting it if needed.
+   *
+   * @return Pointer to the emulated NIC. On error, returns nullptr.
+   */
+  static SoftwareNic* Acquire() noexcept;
+
+  /**
+   * @brief Releases a reference obtained with `Acquire()`. The emulator is
+   *        stopped when the last reference is released.
+   */
+  static void Release() noexcept;
+
+  /**
+   * @brief Must be called after every write to a queue address register
+   *        (`rx_mem_low`, `rx_mem_high`, `tx_mem_low` or `tx_mem_high`).
+   *
+   * Enabling or disabling a queue only returns after the emulator thread has
+   * observed the change. This guarantees that the emulator no longer touches
+   * a buffer once the queue that uses it has been disabled.
+   *
+   * @param offset Offset of the register within BAR 2.
+   * @param value Value that was written to the register.
+   */
+  static void OnAddrRegWrite(uint64_t offset, uint32_t value) noexcept;
+
+  /**
+   * @brief Size of the emulated BAR 2 in bytes.
+   */
+  static constexpr size_t kBar2Size =
+      (size_t)kMemorySpacePerQueue * (kMaxNbFlows + kMaxNbApps);
+
+  void* bar2_addr() const noexcept { return bar2_addr_; }
+
+  int AllocateNotifBuf() noexcept;
+  int FreeNotifBuf(int notif_buf_id) noexcept;
+  int AllocatePipe(bool fallback) noexcept;
+  int FreePipe(int pipe_id) noexcept;
+  int SetPipeSize(int pipe_id, uint32_t nb_flits) noexcept;
+  int GetNbFallbackQueues() noexcept;
+  int SetRrStatus(bool enable_rr) noexcept;
+  int GetRrStatus() noexcept;
+
+ private:
+  struct EmuNotifBuf {
+    struct RxNotification* rx_buf;
+    struct TxNotification* tx_buf;
+    struct QueueRegs* regs;
+    uint32_t rx_tail;
+    uint32_t tx_head;
+    bool active;
+  };
+
+  struct EmuPipe {
+    uint8_t* buf;
+    struct QueueRegs* regs;
+    uint32_t notif_buf_id;
+    uint32_t tail;
+    uint32_t mask;  // Pipe size (in flits) minus one.
+    bool active;
+  };
+
+  struct FlowEntry {
+    uint16_t dst_port;
+    uint16_t src_port;
+    uint32_t dst_ip;
+    uint32_t src_ip;
+    uint32_t protocol;
+    enso_pipe_id_t pipe_id;
+    std::vector<uint8_t> pkt;  // Template for the packets of this flow.
+  };
+
+  SoftwareNic() noexcept = default;
+  ~SoftwareNic() noexcept;
+
+  SoftwareNic(const SoftwareNic& other) = delete;
+  SoftwareNic& operator=(const SoftwareNic& other) = delete;
+  SoftwareNic(SoftwareNic&& other) = delete;
+  SoftwareNic& operator=(SoftwareNic&& other) = delete;
+
+  int Init() noexcept;
+
+  void SetQueueState(uint64_t offset, uint32_t value) noexcept;
+
+  /**
+   * @brief Emulator main loop. Runs until `running_` is cleared.
+   */
+  void Run() noexcept;
+
+  /**
+   * @brief Brings the emulator's view of the enabled queues up to date with
+   *        the register state.
+   */
+  void SyncQueues() noexcept;
+
+  uint32_t ProcessTx(EmuNotifBuf* notif_buf) noexcept;
+
+  void ApplyConfig(const struct TxNotification* config) noexcept;
+
+  uint32_t DeliverBurst(enso_pipe_id_t pipe_id, const uint8_t* pkt) noexcept;
+
+  uint32_t GeneratePackets() noexcept;
+
+  void BuildPacket(std::vector<uint8_t>* pkt, uint32_t dst_ip, uint32_t src_ip,
+                   uint16_t dst_port, uint16_t src_port,
+                   uint32_t protocol) const noexcept;
+
+  static SoftwareNic* instance_;
+  static std::mutex instance_mutex_;
+  static uint32_t ref_cnt_;
+
+  void* bar2_addr_ = nullptr;
+
+  // Protected by `mutex_`.
+  std::mutex mutex_;
+  std::vector<bool> pipe_allocated_;
+  std::vector<bool> pipe_enabled_;
+  std::vector<uint32_t> pipe_sizes_;  // In flits.
+  std::vector<bool> notif_buf_allocated_;
+  std::vector<bool> notif_buf_enabled_;
+  uint32_t nb_fallback_pipes_ = 0;
+  bool rr_status_ = false;
+
+  std::atomic<uint64_t> requested_version_ = 0;
+  std::atomic<uint64_t> applied_version_ = 0;
+  std::atomic<bool> running_ = false;
+  std::thread thread_;
+
+  // Only accessed by the emulator thread.
+  std::vector<EmuPipe> pipes_;
+  std::vector<EmuNotifBuf> notif_bufs_;
+  std::vector<uint32_t> active_notif_bufs_;
+  std::vector<FlowEntry> flows_;
+  std::vector<uint8_t> fallback_pkt_;
+  uint32_t fallback_nb_queues_ = 0;
+  uint32_t fallback_mask_ = 0;
+  bool fallback_rr_ = false;
+  uint64_t fallback_cnt_ = 0;
+  uint32_t pkt_size_ = 64;
+  uint32_t burst_size_ = 16;
+  int core_id_ = -1;
+};
+
+}  // namespace enso
+
+#endif  // ENSO_SOFTWARE_SRC_BACKENDS_SOFTWARE_SOFTWARE_NIC_H_
@@ -41,16 +41,29 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace enso {
 
+/**
+ * @brief Returns a file descriptor for `/proc/self/pagemap`.
+ *
+ * The file is opened only once and shared by all threads. We only use `pread`,
+ * which does not change the file offset.
+ */
+static int get_pagemap_fd() {
+  static const int fd = open("/proc/self/pagemap", O_RDONLY);
+  return fd;
+}
+
 uint64_t virt_to_phys(void* virt) {
-  long page_size = sysconf(_SC_PAGESIZE);
-  int fd = open("/proc/self/pagemap", O_RDONLY);
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  int fd = get_pagemap_fd();
 
   if (fd < 0) {
     return 0;
@@ -58,17 +71,11 @@ uint64_t virt_to_phys(void* virt) {
 
   // Pagemap is an array of pointers for each normal-sized page.
   off_t offset = (uintptr_t)virt / page_size * sizeof(uintptr_t);
-  if (lseek(fd, offset, SEEK_SET) < 0) {
-    close(fd);
-    return 0;
-  }
 
   uintptr_t phy = 0;
-  if (read(fd, &phy, sizeof(phy)) < 0) {
-    close(fd);
+  if (pread(fd, &phy, sizeof(phy), offset) != sizeof(phy)) {
     return 0;
   }
-  close(fd);
 
   if (!phy) {
     return 0;
@@ -79,6 +86,61 @@ uint64_t virt_to_phys(void* virt) {
                     ((uintptr_t)virt) % page_size);
 }
 
+int virt_to_phys_batch(void* virt, size_t stride, uint32_t nb_addrs,
+                       uint64_t* phys) {
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  constexpr size_t kMaxEntriesPerRead = 1 << 15;
+
+  size_t entries_per_addr = stride / page_size;
+
+  // Pagemap is an array of entries for each normal-sized page. When the
+  // addresses are close enough, we read all the entries between them at once.
+  // Otherwise, we fall back to converting one address at a time.
+  if (stride % page_size != 0 || entries_per_addr == 0 ||
+      entries_per_addr >= kMaxEntriesPerRead) {
+    for (uint32_t i = 0; i < nb_addrs; ++i) {
+      phys[i] = virt_to_phys((uint8_t*)virt + i * stride);
+      if (phys[i] == 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  int fd = get_pagemap_fd();
+  if (fd < 0) {
+    return -1;
+  }
+
+  uint32_t addrs_per_read = kMaxEntriesPerRead / entries_per_addr;
+  std::vector<uint64_t> entries(kMaxEntriesPerRead);
+
+  for (uint32_t i = 0; i < nb_addrs; i += addrs_per_read) {
+    uint32_t nb_addrs_in_read = std::min(addrs_per_read, nb_addrs - i);
+    uintptr_t first_virt = (uintptr_t)virt + i * stride;
+    off_t offset = first_virt / page_size * sizeof(uint64_t);
+    ssize_t len =
+        ((nb_addrs_in_read - 1) * entries_per_addr + 1) * sizeof(uint64_t);
+
+    if (pread(fd, entries.data(), len, offset) != len) {
+      return -1;
+    }
+
+    for (uint32_t j = 0; j < nb_addrs_in_read; ++j) {
+      uint64_t entry = entries[j * entries_per_addr];
+      if (!entry) {
+        return -1;
+      }
+
+      // Bits 0-54 are the page number.
+      phys[i + j] = (entry & 0x7fffffffffffffULL) * page_size +
+                    (first_virt + j * stride) % page_size;
+    }
+  }
+
+  return 0;
+}
+
 void* get_huge_page(const std::string& path, size_t size, bool mirror) {
   int fd;
   if (size == 0) {
@@ -146,4 +208,164 @@ void* get_huge_page(const std::string& path, size_t size, bool mirror) {
   return virt_addr;
 }
 
+void* get_mirrored_buf(size_t size) {
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (size < (size_t)page_size || size >= kBufPageSize ||
+      (size & (size - 1)) != 0) {
+    std::cerr << "Unsupported mirrored buffer size: " << size << std::endl;
+    return nullptr;
+  }
+
+  int fd = memfd_create("enso_pipe", 0);
+  if (fd == -1) {
+    std::cerr << "(" << errno << ") Could not create memory file" << std::endl;
+    return nullptr;
+  }
+
+  if (ftruncate(fd, (off_t)size)) {
+    std::cerr << "(" << errno << ") Could not truncate memory file to size: "
+              << size << std::endl;
+    close(fd);
+    return nullptr;
+  }
+
+  // Reserve twice the space we need, so that we can align the buffer and its
+  // mirror to their combined size. The buffer is made of regular pages, which
+  // are not physically contiguous. It can therefore only be shared with
+  // devices that use virtual addresses, like the software backend.
+  size_t mirrored_size = size * 2;
+  uint8_t* reserved =
+      (uint8_t*)mmap(nullptr, mirrored_size * 2, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reserved == (void*)-1) {
+    std::cerr << "(" << errno << ") Could not reserve memory" << std::endl;
+    close(fd);
+    return nullptr;
+  }
+  uint8_t* virt_addr =
+      (uint8_t*)(((uint64_t)reserved + mirrored_size - 1) &
+                 ~((uint64_t)mirrored_size - 1));
+  if (virt_addr > reserved) {
+    munmap(reserved, virt_addr - reserved);
+  }
+  munmap(virt_addr + mirrored_size,
+         reserved + mirrored_size * 2 - (virt_addr + mirrored_size));
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    void* ret = mmap(virt_addr + i * size, size, PROT_READ | PROT_WRITE,
+                     MAP_FIXED | MAP_SHARED, fd, 0);
+    if (ret == (void*)-1) {
+      std::cerr << "(" << errno << ") Could not mmap memory file" << std::endl;
+      munmap(virt_addr, mirrored_size);
+      close(fd);
+      return nullptr;
+    }
+  }
+
+  // The mappings keep the memory alive.
+  close(fd);
+
+  if (mlock(virt_addr, size)) {
+    std::cerr << "(" << errno << ") Could not lock memory" << std::endl;
+    munmap(virt_addr, mirrored_size);
+    return nullptr;
+  }
+
+  return virt_addr;
+}
+
+void free_mirrored_buf(void* buf, size_t size) { munmap(buf, size * 2); }
+
+int huge_page_arena_init(struct HugePageArena* arena, const std::string& path) {
+  arena->path = path;
+  arena->nb_slots = 0;
+  arena->fd = open(path.c_str(), O_CREAT | O_RDWR, S_IRWXU);
+  if (arena->fd == -1) {
+    std::cerr << "(" << errno << ") Problem opening huge page file descriptor"
+              << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+void* huge_page_arena_alloc(struct HugePageArena* arena) {
+  uint32_t slot;
+  if (arena->free_slots.empty()) {
+    slot = arena->nb_slots;
+    if (ftruncate(arena->fd, (off_t)(slot + 1) * kBufPageSize)) {
+      std::cerr << "(" << errno << ") Could not grow huge page arena"
+                << std::endl;
+      return nullptr;
+    }
+    ++(arena->nb_slots);
+  } else {
+    slot = arena->free_slots.back();
+    arena->free_slots.pop_back();
+  }
+
+  off_t offset = (off_t)slot * kBufPageSize;
+  void* virt_addr =
+      (void*)mmap(nullptr, kBufPageSize * 2, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_HUGETLB, arena->fd, offset);
+  if (virt_addr == (void*)-1) {
+    std::cerr << "(" << errno << ") Could not mmap huge page" << std::endl;
+    arena->free_slots.push_back(slot);
+    return nullptr;
+  }
+
+  // Map the same slot again at the end of the first mapping.
+  void* ret = (void*)mmap((uint8_t*)virt_addr + kBufPageSize, kBufPageSize,
+                          PROT_READ | PROT_WRITE,
+                          MAP_FIXED | MAP_SHARED | MAP_HUGETLB, arena->fd,
+                          offset);
+  if (ret == (void*)-1) {
+    std::cerr << "(" << errno << ") Could not mmap second huge page"
+              << std::endl;
+    munmap(virt_addr, kBufPageSize * 2);
+    arena->free_slots.push_back(slot);
+    return nullptr;
+  }
+
+  if (mlock(virt_addr, kBufPageSize)) {
+    std::cerr << "(" << errno << ") Could not lock huge page" << std::endl;
+    munmap(virt_addr, kBufPageSize * 2);
+    arena->free_slots.push_back(slot);
+    return nullptr;
+  }
+
+  arena->slots[virt_addr] = slot;
+
+  return virt_addr;
+}
+
+void huge_page_arena_free(struct HugePageArena* arena, void* buf) {
+  auto it = arena->slots.find(buf);
+  if (it == arena->slots.end()) {
+    return;
+  }
+  uint32_t slot = it->second;
+  arena->slots.erase(it);
+
+  munmap(buf, kBufPageSize * 2);  // Includes the mirror.
+
+  // We keep the huge page in the file, so that reusing the slot does not
+  // require the kernel to allocate and zero a new one.
+  arena->free_slots.push_back(slot);
+}
+
+void huge_page_arena_destroy(struct HugePageArena* arena) {
+  for (auto& [buf, slot] : arena->slots) {
+    munmap(buf, kBufPageSize * 2);
+  }
+  arena->slots.clear();
+  arena->free_slots.clear();
+  arena->nb_slots = 0;
+
+  if (arena->fd != -1) {
+    close(arena->fd);
+    unlink(arena->path.c_str());
+    arena->fd = -1;
+  }
+}
+
 }  // namespace enso
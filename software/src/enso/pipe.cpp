@@ -40,15 +40,19 @@
 #include <enso/config.h>
 #include <enso/helpers.h>
 #include <enso/pipe.h>
+#include <enso/simd.h>
+#include <immintrin.h>
 #include <sched.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdio>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <string>
 
 #include "../pcie.h"
@@ -67,12 +71,6 @@ int RxPipe::Bind(uint16_t dst_port, uint16_t src_port, uint32_t dst_ip,
                            src_ip, protocol, id_);
 }
 
-uint32_t RxPipe::Recv(uint8_t** buf, uint32_t max_nb_bytes) {
-  uint32_t ret = Peek(buf, max_nb_bytes);
-  ConfirmBytes(ret);
-  return ret;
-}
-
 inline void RxPipe::SetPktSentTime(uint32_t tail, uint64_t sent_time) {
   // uint32_t* enso_pipe_buf = internal_rx_pipe_.buf;
   // uint8_t* pkt = (uint8_t*)&enso_pipe_buf[tail * 16];
@@ -81,30 +79,126 @@ inline void RxPipe::SetPktSentTime(uint32_t tail, uint64_t sent_time) {
   (void)sent_time;
 }
 
-inline uint32_t RxPipe::Peek(uint8_t** buf, uint32_t max_nb_bytes) {
-  if (!next_pipe_) {
-    get_new_tails(notification_buf_pair_);
+void RxPipe::Prefetch() { prefetch_pipe(&internal_rx_pipe_); }
+
+/**
+ * @brief Sets or clears `nb_flits` bits in `bitmap`, starting at `first_flit`
+ * and wrapping around at the pipe size (`pipe_mask + 1`).
+ */
+static void set_flit_bits(uint64_t* bitmap, uint32_t first_flit,
+                          uint32_t nb_flits, uint32_t pipe_mask, bool value) {
+  uint32_t flit = first_flit;
+  while (nb_flits > 0) {
+    uint32_t bit = flit % 64;
+    uint32_t nb_bits = std::min(nb_flits, 64 - bit);
+    uint64_t mask = (nb_bits == 64) ? ~0ULL : ((1ULL << nb_bits) - 1) << bit;
+    if (value) {
+      bitmap[flit / 64] |= mask;
+    } else {
+      bitmap[flit / 64] &= ~mask;
+    }
+    nb_flits -= nb_bits;
+    flit = (flit + nb_bits) & pipe_mask;
   }
-  uint32_t ret = peek_next_batch_from_queue(
-      &internal_rx_pipe_, notification_buf_pair_, (void**)buf);
-  return std::min(ret, max_nb_bytes);
 }
 
-void RxPipe::Free(uint32_t nb_bytes) {
-  advance_pipe(&internal_rx_pipe_, nb_bytes);
+void RxPipe::ForgetFreedFlits(uint32_t old_rx_head) {
+  if (freed_flits_ == nullptr) {
+    return;
+  }
+  uint32_t mask = internal_rx_pipe_.mask;
+  uint32_t nb_flits = (internal_rx_pipe_.rx_head - old_rx_head) & mask;
+  set_flit_bits(freed_flits_, old_rx_head, nb_flits, mask, false);
+
+  // The new head may have reached flits that were already released.
+  FreeReleasedRun();
+}
+
+void RxPipe::FreeReleasedRun() {
+  uint32_t mask = internal_rx_pipe_.mask;
+  uint32_t rx_head = internal_rx_pipe_.rx_head;
+  uint32_t nb_owned_flits = (internal_rx_pipe_.rx_tail - rx_head) & mask;
+
+  // Find how many flits after the head are contiguously freed.
+  uint32_t nb_freed_flits = 0;
+  uint32_t flit = rx_head;
+  while (nb_freed_flits < nb_owned_flits) {
+    uint32_t bit = flit % 64;
+    uint64_t bits = freed_flits_[flit / 64] >> bit;
+    uint32_t run = (~bits == 0) ? 64 : __builtin_ctzll(~bits);
+    run = std::min(run, nb_owned_flits - nb_freed_flits);
+    nb_freed_flits += run;
+    flit = (flit + run) & mask;
+    if (run < 64 - bit) {
+      break;
+    }
+  }
+
+  if (nb_freed_flits > 0) {
+    set_flit_bits(freed_flits_, rx_head, nb_freed_flits, mask, false);
+    advance_pipe(&internal_rx_pipe_, nb_freed_flits * 64);
+  }
 }
 
-void RxPipe::Prefetch() { prefetch_pipe(&internal_rx_pipe_); }
+int RxPipe::FreeRange(const uint8_t* start, uint32_t nb_bytes) {
+  uint32_t mask = internal_rx_pipe_.mask;
+
+  if (unlikely(freed_flits_ == nullptr)) {
+    freed_flits_ = new (std::nothrow) uint64_t[(mask + 1) / 64]();
+    if (freed_flits_ == nullptr) {
+      std::cerr << "Could not allocate memory" << std::endl;
+      return -1;
+    }
+  }
+
+  if (unlikely(start < buf())) {
+    return -1;
+  }
+
+  uint32_t rx_head = internal_rx_pipe_.rx_head;
+  uint32_t nb_owned_flits = (internal_rx_pipe_.rx_tail - rx_head) & mask;
 
-void RxPipe::Clear() { fully_advance_pipe(&internal_rx_pipe_); }
+  // The buffer is mapped twice, so `start` may be in either mapping.
+  uint64_t offset = (uint64_t)(start - buf()) % buf_size();
+  uint32_t first_flit = offset / 64;
+  uint32_t nb_flits = nb_bytes / 64 + (nb_bytes % 64 != 0);
+  uint32_t flits_from_head = (first_flit - rx_head) & mask;
+
+  if (unlikely(offset % 64 != 0 ||
+               flits_from_head + nb_flits > nb_owned_flits)) {
+    return -1;
+  }
+
+  set_flit_bits(freed_flits_, first_flit, nb_flits, mask, true);
+  FreeReleasedRun();
+
+  return 0;
+}
+
+int RxPipe::SetHeadUpdateThreshold(uint32_t nb_bytes) {
+  uint32_t nb_flits = nb_bytes / 64 + (nb_bytes % 64 != 0);
+  return set_pipe_head_update_threshold(&internal_rx_pipe_, nb_flits);
+}
+
+void RxPipe::Flush() { flush_pipe_head(&internal_rx_pipe_); }
 
 RxPipe::~RxPipe() {
-  enso_pipe_free(notification_buf_pair_, &internal_rx_pipe_, id_);
+  // Pipes that failed to initialize may not have been allocated.
+  if (internal_rx_pipe_.regs != nullptr) {
+    enso_pipe_free(notification_buf_pair_, &internal_rx_pipe_,
+                   internal_rx_pipe_.id);
+  }
+  delete[] freed_flits_;
 }
 
-int RxPipe::Init(bool fallback) noexcept {
-  int ret =
-      enso_pipe_init(&internal_rx_pipe_, notification_buf_pair_, fallback);
+int RxPipe::Init(bool fallback, uint32_t buf_size) noexcept {
+  static_assert(offsetof(RxPipe, internal_rx_pipe_) +
+                        kRxEnsoPipeInternalHotSize <=
+                    kCacheLineSize,
+                "RxPipe hot fields must fit in a single cache line");
+
+  int ret = enso_pipe_init(&internal_rx_pipe_, notification_buf_pair_,
+                           fallback, buf_size / 64);
   if (ret < 0) {
     return ret;
   }
@@ -115,24 +209,21 @@ int RxPipe::Init(bool fallback) noexcept {
 }
 
 TxPipe::~TxPipe() {
-  if (internal_buf_) {
-    munmap(buf_, kMaxCapacity);
-    std::string path = GetHugePageFilePath();
-    unlink(path.c_str());
+  if (internal_buf_ && buf_) {
+    huge_page_arena_free(device_->notification_buf_pair_.pipe_buf_arena, buf_);
   }
 }
 
 int TxPipe::Init() noexcept {
+  struct NotificationBufPair* notif_buf = &(device_->notification_buf_pair_);
+
   if (internal_buf_) {
-    std::string path = GetHugePageFilePath();
-    buf_ = (uint8_t*)get_huge_page(path, 0, true);
+    buf_ = (uint8_t*)huge_page_arena_alloc(notif_buf->pipe_buf_arena);
     if (unlikely(!buf_)) {
       return -1;
     }
   }
 
-  struct NotificationBufPair* notif_buf = &(device_->notification_buf_pair_);
-
   buf_phys_addr_ = get_dev_addr_from_virt_addr(notif_buf, buf_);
   return 0;
 }
@@ -141,13 +232,13 @@ void RxTxPipe::SetPktSentTime(uint32_t tail, uint64_t sent_time) {
   rx_pipe_->SetPktSentTime(tail, sent_time);
 }
 
-int RxTxPipe::Init(bool fallback) noexcept {
-  rx_pipe_ = device_->AllocateRxPipe(fallback);
+int RxTxPipe::Init(bool fallback, uint32_t buf_size) noexcept {
+  rx_pipe_ = device_->AllocateRxPipe(fallback, buf_size);
   if (rx_pipe_ == nullptr) {
     return -1;
   }
 
-  tx_pipe_ = device_->AllocateTxPipe(rx_pipe_->buf());
+  tx_pipe_ = device_->AllocateTxPipe(rx_pipe_->buf(), buf_size);
   if (tx_pipe_ == nullptr) {
     return -1;
   }
@@ -157,6 +248,138 @@ int RxTxPipe::Init(bool fallback) noexcept {
   return 0;
 }
 
+int PipeGroup::Add(RxPipe* pipe) noexcept {
+  if (pipe->notification_buf_pair_ != notification_buf_pair_) {
+    std::cerr << "Pipe was not allocated by the same device as the group"
+              << std::endl;
+    return -1;
+  }
+
+  const struct RxEnsoPipeInternal& internal = pipe->internal_rx_pipe_;
+  slots_.push_back(internal.slot);
+  rx_tails_.push_back(internal.rx_tail);
+  bufs_.push_back((uint8_t*)internal.buf);
+  rx_pipes_.push_back(pipe);
+
+  return rx_pipes_.size() - 1;
+}
+
+int PipeGroup::Add(RxTxPipe* pipe) noexcept { return Add(pipe->rx_pipe_); }
+
+// Compares the tails of 16 pipes at a time, gathering their latest tails from
+// the notification buffer.
+__attribute__((target("avx512f"))) static uint32_t scan_pipes_avx512(
+    const struct RxPipeSlot* rx_pipe_slots, const uint32_t* slots,
+    const uint32_t* rx_tails, uint32_t begin, uint32_t end, uint32_t* indices,
+    uint32_t nb_indices, uint32_t max_nb_pipes) {
+  constexpr uint32_t kLanes = 16;
+  for (uint32_t i = begin; i < end && nb_indices < max_nb_pipes; i += kLanes) {
+    uint32_t nb_lanes = std::min(end - i, kLanes);
+    __mmask16 valid = (__mmask16)((1U << nb_lanes) - 1);
+
+    __m512i slot_idxs = _mm512_maskz_loadu_epi32(valid, &slots[i]);
+    __m512i pending_tails = _mm512_mask_i32gather_epi32(
+        _mm512_setzero_si512(), valid, slot_idxs, &rx_pipe_slots->pending_tail,
+        sizeof(struct RxPipeSlot));
+    __m512i old_tails = _mm512_maskz_loadu_epi32(valid, &rx_tails[i]);
+
+    uint32_t new_data =
+        _mm512_mask_cmpneq_epi32_mask(valid, pending_tails, old_tails);
+    while (new_data && nb_indices < max_nb_pipes) {
+      indices[nb_indices++] = i + __builtin_ctz(new_data);
+      new_data &= new_data - 1;
+    }
+  }
+  return nb_indices;
+}
+
+// Same as `scan_pipes_avx512()`, with 8 pipes at a time.
+__attribute__((target("avx2"))) static uint32_t scan_pipes_avx2(
+    const struct RxPipeSlot* rx_pipe_slots, const uint32_t* slots,
+    const uint32_t* rx_tails, uint32_t begin, uint32_t end, uint32_t* indices,
+    uint32_t nb_indices, uint32_t max_nb_pipes) {
+  constexpr uint32_t kLanes = 8;
+  const __m256i lane_ids = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+  for (uint32_t i = begin; i < end && nb_indices < max_nb_pipes; i += kLanes) {
+    uint32_t nb_lanes = std::min(end - i, kLanes);
+    __m256i valid =
+        _mm256_cmpgt_epi32(_mm256_set1_epi32(nb_lanes), lane_ids);
+
+    __m256i slot_idxs = _mm256_maskload_epi32((const int*)&slots[i], valid);
+    __m256i pending_tails = _mm256_mask_i32gather_epi32(
+        _mm256_setzero_si256(), (const int*)&rx_pipe_slots->pending_tail,
+        slot_idxs, valid, sizeof(struct RxPipeSlot));
+    __m256i old_tails = _mm256_maskload_epi32((const int*)&rx_tails[i], valid);
+
+    __m256i same = _mm256_cmpeq_epi32(pending_tails, old_tails);
+    __m256i changed = _mm256_andnot_si256(same, valid);
+    uint32_t new_data = _mm256_movemask_ps(_mm256_castsi256_ps(changed));
+    while (new_data && nb_indices < max_nb_pipes) {
+      indices[nb_indices++] = i + __builtin_ctz(new_data);
+      new_data &= new_data - 1;
+    }
+  }
+  return nb_indices;
+}
+
+static uint32_t scan_pipes_scalar(const struct RxPipeSlot* rx_pipe_slots,
+                                  const uint32_t* slots,
+                                  const uint32_t* rx_tails, uint32_t begin,
+                                  uint32_t end, uint32_t* indices,
+                                  uint32_t nb_indices, uint32_t max_nb_pipes) {
+  for (uint32_t i = begin; i < end && nb_indices < max_nb_pipes; ++i) {
+    if (rx_pipe_slots[slots[i]].pending_tail != rx_tails[i]) {
+      indices[nb_indices++] = i;
+    }
+  }
+  return nb_indices;
+}
+
+uint32_t PipeGroup::ScanPipes(uint32_t begin, uint32_t end, uint32_t* indices,
+                              uint32_t nb_indices,
+                              uint32_t max_nb_pipes) noexcept {
+  const struct RxPipeSlot* rx_pipe_slots =
+      notification_buf_pair_->rx_pipe_slots;
+
+  switch (simd_isa()) {
+    case SimdIsa::kAvx512:
+      return scan_pipes_avx512(rx_pipe_slots, slots_.data(), rx_tails_.data(),
+                               begin, end, indices, nb_indices, max_nb_pipes);
+    case SimdIsa::kAvx2:
+      return scan_pipes_avx2(rx_pipe_slots, slots_.data(), rx_tails_.data(),
+                             begin, end, indices, nb_indices, max_nb_pipes);
+    default:
+      return scan_pipes_scalar(rx_pipe_slots, slots_.data(), rx_tails_.data(),
+                               begin, end, indices, nb_indices, max_nb_pipes);
+  }
+}
+
+uint32_t PipeGroup::PollAll(uint32_t* indices, uint32_t max_nb_pipes) noexcept {
+  // Only the pipes returned last time may have been received from since then.
+  for (uint32_t index : polled_) {
+    rx_tails_[index] = rx_pipes_[index]->internal_rx_pipe_.rx_tail;
+  }
+  polled_.clear();
+
+  get_new_tails(notification_buf_pair_);
+
+  uint32_t nb_pipes = ScanPipes(next_index_, size(), indices, 0, max_nb_pipes);
+  nb_pipes = ScanPipes(0, next_index_, indices, nb_pipes, max_nb_pipes);
+
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    uint32_t index = indices[i];
+    polled_.push_back(index);
+    _mm_prefetch(bufs_[index] + rx_tails_[index] * 64, _MM_HINT_T0);
+    rx_pipes_[index]->SetAsNextPipe();
+  }
+
+  if (nb_pipes > 0) {
+    next_index_ = (indices[nb_pipes - 1] + 1) % size();
+  }
+
+  return nb_pipes;
+}
+
 std::unique_ptr<Device> Device::Create(
     const std::string& pcie_addr, const std::string& huge_page_prefix,
     int32_t uthread_id, CompletionCallback completion_callback) noexcept {
@@ -175,12 +398,10 @@ std::unique_ptr<Device> Device::Create(
 
 Device::~Device() {
   for (auto& pipe : rx_tx_pipes_) {
-    rx_tx_pipes_map_[pipe->rx_id()] = nullptr;
     delete pipe;
   }
 
   for (auto& pipe : rx_pipes_) {
-    rx_pipes_map_[pipe->id()] = nullptr;
     delete pipe;
   }
 
@@ -188,33 +409,144 @@ Device::~Device() {
     delete pipe;
   }
 
+  for (auto& pipe : rx_pipe_pool_) {
+    delete pipe;
+  }
+
+  for (auto& region : memory_regions_) {
+    delete region;
+  }
+
+  for (auto& group : pipe_groups_) {
+    delete group;
+  }
+
   notification_buf_free(&notification_buf_pair_);
 }
 
-RxPipe* Device::AllocateRxPipe(bool fallback) noexcept {
-  RxPipe* pipe(new (std::nothrow) RxPipe(this));
+RxPipe* Device::AllocateRxPipe(bool fallback, uint32_t buf_size) noexcept {
+  RxPipe* pipe;
 
-  if (unlikely(!pipe)) {
+  if (!fallback && buf_size == kEnsoPipeSize * 64 && !rx_pipe_pool_.empty()) {
+    pipe = rx_pipe_pool_.back();
+    rx_pipe_pool_.pop_back();
+  } else {
+    pipe = new (std::nothrow) RxPipe(this);
+
+    if (unlikely(!pipe)) {
+      return nullptr;
+    }
+
+    if (pipe->Init(fallback, buf_size)) {
+      delete pipe;
+      return nullptr;
+    }
+  }
+
+  rx_pipes_.push_back(pipe);
+
+  uint32_t slot = pipe->internal_rx_pipe_.slot;
+  if (slot >= rx_pipes_by_slot_.size()) {
+    rx_pipes_by_slot_.resize(slot + 1, nullptr);
+  }
+  rx_pipes_by_slot_[slot] = pipe;
+
+  return pipe;
+}
+
+const MemoryRegion* Device::RegisterMemory(void* addr, size_t size) noexcept {
+  uint8_t* base = (uint8_t*)((uint64_t)addr & ~((uint64_t)kBufPageSize - 1));
+  uint8_t* end = (uint8_t*)addr + size;
+  uint32_t nb_pages = (end - base + kBufPageSize - 1) / kBufPageSize;
+
+  MemoryRegion* region(new (std::nothrow) MemoryRegion(base, end));
+  if (unlikely(!region)) {
     return nullptr;
   }
 
-  if (pipe->Init(fallback)) {
-    delete pipe;
+  region->page_dev_addrs_.resize(nb_pages);
+  if (get_dev_addrs_from_virt_addrs(&notification_buf_pair_, base,
+                                    kBufPageSize, nb_pages,
+                                    region->page_dev_addrs_.data())) {
+    std::cerr << "Could not translate memory addresses" << std::endl;
+    delete region;
     return nullptr;
   }
 
-  rx_pipes_.push_back(pipe);
-  rx_pipes_map_[pipe->id()] = pipe;
+  memory_regions_.push_back(region);
 
-  return pipe;
+  return region;
+}
+
+void Device::DeregisterMemory(const MemoryRegion* region) noexcept {
+  for (auto it = memory_regions_.begin(); it != memory_regions_.end(); ++it) {
+    if (*it == region) {
+      delete *it;
+      memory_regions_.erase(it);
+      return;
+    }
+  }
+}
+
+PipeGroup* Device::AllocatePipeGroup() noexcept {
+  PipeGroup* group(new (std::nothrow) PipeGroup(this));
+  if (unlikely(!group)) {
+    return nullptr;
+  }
+
+  pipe_groups_.push_back(group);
+
+  return group;
+}
+
+int Device::FillPipePool(uint32_t nb_pipes) noexcept {
+  std::vector<RxPipe*> pipes;
+  std::vector<struct RxEnsoPipeInternal*> enso_pipes;
+
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    RxPipe* pipe(new (std::nothrow) RxPipe(this));
+    if (unlikely(!pipe)) {
+      break;
+    }
+    pipes.push_back(pipe);
+    enso_pipes.push_back(&pipe->internal_rx_pipe_);
+  }
+
+  if (pipes.size() < nb_pipes ||
+      enso_pipes_init(enso_pipes.data(), nb_pipes, &notification_buf_pair_,
+                      false)) {
+    for (auto& pipe : pipes) {
+      delete pipe;
+    }
+    return -1;
+  }
+
+  for (auto& pipe : pipes) {
+    pipe->id_ = pipe->internal_rx_pipe_.id;
+    rx_pipe_pool_.push_back(pipe);
+  }
+
+  return 0;
 }
 
 int Device::GetNbFallbackQueues() noexcept {
   return get_nb_fallback_queues(&notification_buf_pair_);
 }
 
-TxPipe* Device::AllocateTxPipe(uint8_t* buf) noexcept {
-  TxPipe* pipe(new (std::nothrow) TxPipe(tx_pipes_.size(), this, buf));
+TxPipe* Device::AllocateTxPipe(uint8_t* buf, uint32_t buf_size) noexcept {
+  if (buf == nullptr) {
+    buf_size = kEnsoPipeSize * 64;
+  } else if (buf_size < TxPipe::kQuantumSize || buf_size > kBufPageSize ||
+             (buf_size & (buf_size - 1)) != 0) {
+    // Requests sent to the device wrap around at huge page boundaries.
+    std::cerr << "TX pipe buffer size must be a power of two between "
+              << TxPipe::kQuantumSize << " and " << kBufPageSize << " bytes"
+              << std::endl;
+    return nullptr;
+  }
+
+  TxPipe* pipe(new (std::nothrow)
+                   TxPipe(tx_pipes_.size(), this, buf, buf_size));
 
   if (unlikely(!pipe)) {
     return nullptr;
@@ -226,28 +558,50 @@ TxPipe* Device::AllocateTxPipe(uint8_t* buf) noexcept {
   }
 
   tx_pipes_.push_back(pipe);
+  rx_tx_pipes_by_tx_id_.push_back(nullptr);
 
   return pipe;
 }
 
-RxTxPipe* Device::AllocateRxTxPipe(bool fallback) noexcept {
+RxTxPipe* Device::AllocateRxTxPipe(bool fallback, uint32_t buf_size) noexcept {
+  if (buf_size > kBufPageSize) {
+    std::cerr << "RX/TX pipe buffer size must be at most " << kBufPageSize
+              << " bytes" << std::endl;
+    return nullptr;
+  }
+
   RxTxPipe* pipe(new (std::nothrow) RxTxPipe(this));
 
   if (unlikely(!pipe)) {
     return nullptr;
   }
 
-  if (pipe->Init(fallback)) {
+  if (pipe->Init(fallback, buf_size)) {
     delete pipe;
     return nullptr;
   }
 
   rx_tx_pipes_.push_back(pipe);
-  rx_tx_pipes_map_[pipe->rx_id()] = pipe;
+  rx_tx_pipes_by_tx_id_[pipe->tx_pipe_->id()] = pipe;
+  completed_rx_tx_pipes_.reserve(rx_tx_pipes_.size());
+
+  uint32_t slot = pipe->rx_pipe_->internal_rx_pipe_.slot;
+  if (slot >= rx_tx_pipes_by_slot_.size()) {
+    rx_tx_pipes_by_slot_.resize(slot + 1, nullptr);
+  }
+  rx_tx_pipes_by_slot_[slot] = pipe;
 
   return pipe;
 }
 
+void Device::WaitForRx(Waiter* waiter) {
+  // Notifications are cache-line aligned, so the signal (the first field) is
+  // safe to watch as a word. It is 0 until the NIC writes the notification.
+  void* rx_notification =
+      notification_buf_pair_.rx_buf + notification_buf_pair_.rx_head;
+  waiter->Wait(static_cast<volatile uint32_t*>(rx_notification), 0);
+}
+
 struct RxNotification* Device::NextRxNotif() {
   // This function can only be used when there are **no** RxTx pipes.
   assert(rx_tx_pipes_.size() == 0);
@@ -268,7 +622,7 @@ RxPipe* Device::NextRxPipeToRecv() {
   }
   int32_t id = notification->queue_id;
 
-  RxPipe* rx_pipe = rx_pipes_map_[id];
+  RxPipe* rx_pipe = GetRxPipe(id);
   if (!rx_pipe) return NULL;
   rx_pipe->SetAsNextPipe();
 
@@ -276,7 +630,7 @@ RxPipe* Device::NextRxPipeToRecv() {
 }
 
 RxTxPipe* Device::NextRxTxPipeToRecv() {
-  ProcessCompletions();
+  MaybeProcessCompletions();
   // This function can only be used when there are only RxTx pipes.
   assert(rx_pipes_.size() == rx_tx_pipes_.size());
   struct RxNotification* notif;
@@ -285,18 +639,34 @@ RxTxPipe* Device::NextRxTxPipeToRecv() {
   notif = get_next_rx_notif(
       &notification_buf_pair_, [this](enso_pipe_id_t enso_pipe_id,
                                       uint64_t sent_time, uint32_t prev_tail) {
-        RxTxPipe* rx_tx_pipe = rx_tx_pipes_map_[enso_pipe_id];
+        RxTxPipe* rx_tx_pipe = GetRxTxPipe(enso_pipe_id);
         rx_tx_pipe->SetPktSentTime(prev_tail, sent_time);
       });
 
   if (!notif) return nullptr;
 
   id = notif->queue_id;
-  RxTxPipe* rx_tx_pipe = rx_tx_pipes_map_[id];
+  RxTxPipe* rx_tx_pipe = GetRxTxPipe(id);
   rx_tx_pipe->rx_pipe_->SetAsNextPipe();
   return rx_tx_pipe;
 }
 
+RxPipe* Device::GetRxPipe(enso_pipe_id_t id) const noexcept {
+  uint32_t slot = get_rx_pipe_slot(&notification_buf_pair_, id);
+  if (unlikely(slot >= rx_pipes_by_slot_.size())) {
+    return nullptr;
+  }
+  return rx_pipes_by_slot_[slot];
+}
+
+RxTxPipe* Device::GetRxTxPipe(enso_pipe_id_t id) const noexcept {
+  uint32_t slot = get_rx_pipe_slot(&notification_buf_pair_, id);
+  if (unlikely(slot >= rx_tx_pipes_by_slot_.size())) {
+    return nullptr;
+  }
+  return rx_tx_pipes_by_slot_[slot];
+}
+
 int Device::GetNotifQueueId() noexcept { return notification_buf_pair_.id; }
 
 struct RxNotification* Device::GetRxNotifQueueBuf() noexcept {
@@ -351,29 +721,51 @@ int Device::ApplyConfig(struct TxNotification* notification) {
                      &completion_callback_);
 }
 
-void Device::Send(int tx_enso_pipe_id, uint64_t phys_addr, uint32_t nb_bytes,
-                  uint64_t sent_time) {
-  // TODO(sadok): We might be able to improve performance by avoiding the wrap
-  // tracker currently used inside send_to_queue.
-  send_to_queue(&notification_buf_pair_, phys_addr, nb_bytes, sent_time);
+void Device::WaitForPendingTxRequests() {
+  // Requests can only complete after the NIC is told about them.
+  FlushTx();
 
   uint32_t nb_pending_requests =
       (tx_pr_tail_ - tx_pr_head_) & kPendingTxRequestsBufMask;
-
-  // This will block until there is enough space to keep at least two requests.
-  // We need space for two requests because the request may be split into two
-  // if the bytes wrap around the end of the buffer.
-  while (unlikely(nb_pending_requests >= (kMaxPendingTxRequests - 2))) {
+  while (nb_pending_requests >= (kMaxPendingTxRequests - 2)) {
     if (park_callback_ != nullptr) std::invoke(park_callback_);
     ProcessCompletions();
     nb_pending_requests =
         (tx_pr_tail_ - tx_pr_head_) & kPendingTxRequestsBufMask;
   }
+}
+
+bool Device::TrySend(int tx_enso_pipe_id, uint64_t phys_addr,
+                     uint32_t nb_bytes, uint64_t sent_time) {
+  if (unlikely(nb_bytes == 0)) {
+    return true;
+  }
+
+  uint32_t nb_pending_requests =
+      (tx_pr_tail_ - tx_pr_head_) & kPendingTxRequestsBufMask;
+
+  // Same limit as `Send()`, but we give up instead of waiting.
+  if (unlikely(nb_pending_requests >= (kMaxPendingTxRequests - 2))) {
+    FlushTx();
+    ProcessCompletions();
+    nb_pending_requests =
+        (tx_pr_tail_ - tx_pr_head_) & kPendingTxRequestsBufMask;
+    if (nb_pending_requests >= (kMaxPendingTxRequests - 2)) {
+      return false;
+    }
+  }
+
+  if (try_send_to_queue(&notification_buf_pair_, phys_addr, nb_bytes,
+                        sent_time) == 0) {
+    return false;
+  }
 
   tx_pending_requests_[tx_pr_tail_].phys_addr = phys_addr;
   tx_pending_requests_[tx_pr_tail_].pipe_id = tx_enso_pipe_id;
   tx_pending_requests_[tx_pr_tail_].nb_bytes = nb_bytes;
   tx_pr_tail_ = (tx_pr_tail_ + 1) & kPendingTxRequestsBufMask;
+
+  return true;
 }
 
 /**
@@ -391,18 +783,49 @@ void Device::ProcessCompletions() {
       // on receiving this, shinkansen should update the notification->signal
       // for applications
       std::invoke(completion_callback_);
+    } else if (tx_req.pipe_id & kForwardedRequestFlag) {
+      RxPipe* pipe = GetRxPipe(tx_req.pipe_id & ~kForwardedRequestFlag);
+      if (unlikely(pipe == nullptr)) {
+        continue;
+      }
+      uint64_t offset =
+          tx_req.phys_addr - pipe->internal_rx_pipe_.buf_phys_addr;
+      if (unlikely(pipe->FreeRange(pipe->buf() + offset, tx_req.nb_bytes))) {
+        // The range stays allocated, the pipe may run out of space.
+        std::cerr << "Could not free forwarded range of pipe "
+                  << pipe->id() << std::endl;
+      }
     } else {
       TxPipe* pipe = tx_pipes_[tx_req.pipe_id];
       // increments app_end_ for the tx pipe by nb_bytes
       pipe->NotifyCompletion(tx_req.nb_bytes);
+
+      RxTxPipe* rx_tx_pipe = rx_tx_pipes_by_tx_id_[tx_req.pipe_id];
+      if (rx_tx_pipe != nullptr && !rx_tx_pipe->has_completions_) {
+        rx_tx_pipe->has_completions_ = true;
+        completed_rx_tx_pipes_.push_back(rx_tx_pipe);
+      }
     }
   }
 
   // RxTx pipes need to be explicitly notified so that they can free space for
-  // more incoming packets.
-  for (RxTxPipe* pipe : rx_tx_pipes_) {
+  // more incoming packets. Only the ones that got completions have any.
+  for (RxTxPipe* pipe : completed_rx_tx_pipes_) {
+    pipe->has_completions_ = false;
     pipe->ProcessCompletions();
   }
+  completed_rx_tx_pipes_.clear();
+}
+
+int Device::SetCompletionsReapInterval(uint32_t nb_calls) {
+  if (nb_calls == 0) {
+    std::cerr << "Completions reap interval must be greater than 0"
+              << std::endl;
+    return -1;
+  }
+  completions_reap_interval_ = nb_calls;
+  calls_to_next_reap_ = nb_calls;
+  return 0;
 }
 
 int Device::EnableTimeStamping(uint8_t offset) {
@@ -441,6 +864,44 @@ int Device::DisableRoundRobin() {
   return disable_round_robin(&notification_buf_pair_);
 }
 
+void Device::EnableNotificationCoalescing() noexcept {
+  set_notif_coalescing(&notification_buf_pair_, true);
+}
+
+void Device::DisableNotificationCoalescing() noexcept {
+  set_notif_coalescing(&notification_buf_pair_, false);
+}
+
+int Device::EnableDeferredTxDoorbell(uint32_t nb_notifications) {
+  return set_tx_flush_threshold(&notification_buf_pair_, nb_notifications);
+}
+
+void Device::DisableDeferredTxDoorbell() {
+  set_tx_flush_threshold(&notification_buf_pair_, 0);
+}
+
+void Device::FlushTx() { flush_tx(&notification_buf_pair_); }
+
+int Device::ForwardAndFree(RxPipe* rx_pipe, const uint8_t* start,
+                           uint32_t nb_bytes) {
+  // Larger buffers span several huge pages that are not physically
+  // contiguous, so the physical address cannot be derived from the offset.
+  if (unlikely(rx_pipe->buf_size() > kBufPageSize)) {
+    std::cerr << "Cannot forward from pipes larger than " << kBufPageSize
+              << " bytes" << std::endl;
+    return -1;
+  }
+
+  // The buffer is mapped twice, so `start` may be in either mapping. Buffers
+  // of a huge page are wrapped around by the NIC. Smaller ones are only
+  // supported by backends that use virtual addresses, which see the mirror.
+  uint64_t offset = (uint64_t)(start - rx_pipe->buf()) % rx_pipe->buf_size();
+  uint64_t phys_addr = rx_pipe->internal_rx_pipe_.buf_phys_addr + offset;
+
+  Send(kForwardedRequestFlag | rx_pipe->id(), phys_addr, nb_bytes);
+  return 0;
+}
+
 int Device::InitializeBackendQueues(uint32_t id) {
   return pcie_initialize_queues(id);
 }
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief SIMD kernels for every supported instruction set.
+ */
+
+#include <enso/simd.h>
+#include <immintrin.h>
+
+namespace enso {
+
+SimdIsa cpu_simd_isa() {
+  // Also checks that the OS saves the wider registers.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SimdIsa::kAvx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdIsa::kAvx2;
+  }
+  return SimdIsa::kSse2;
+}
+
+void memcpy_64_align_sse2(void* dst, const void* src, size_t n) {
+  const __m128i* s = (const __m128i*)src;
+  __m128i* d = (__m128i*)dst;
+  for (; n >= 64; n -= 64, s += 4, d += 4) {
+    __m128i xmm0 = _mm_loadu_si128(s);
+    __m128i xmm1 = _mm_loadu_si128(s + 1);
+    __m128i xmm2 = _mm_loadu_si128(s + 2);
+    __m128i xmm3 = _mm_loadu_si128(s + 3);
+    _mm_store_si128(d, xmm0);
+    _mm_store_si128(d + 1, xmm1);
+    _mm_store_si128(d + 2, xmm2);
+    _mm_store_si128(d + 3, xmm3);
+  }
+}
+
+__attribute__((target("avx2"))) void memcpy_64_align_avx2(void* dst,
+                                                          const void* src,
+                                                          size_t n) {
+  const __m256i* s = (const __m256i*)src;
+  __m256i* d = (__m256i*)dst;
+  // Two cache lines per iteration keep four loads in flight.
+  for (; n >= 128; n -= 128, s += 4, d += 4) {
+    __m256i ymm0 = _mm256_loadu_si256(s);
+    __m256i ymm1 = _mm256_loadu_si256(s + 1);
+    __m256i ymm2 = _mm256_loadu_si256(s + 2);
+    __m256i ymm3 = _mm256_loadu_si256(s + 3);
+    _mm256_store_si256(d, ymm0);
+    _mm256_store_si256(d + 1, ymm1);
+    _mm256_store_si256(d + 2, ymm2);
+    _mm256_store_si256(d + 3, ymm3);
+  }
+  if (n >= 64) {
+    __m256i ymm0 = _mm256_loadu_si256(s);
+    __m256i ymm1 = _mm256_loadu_si256(s + 1);
+    _mm256_store_si256(d, ymm0);
+    _mm256_store_si256(d + 1, ymm1);
+  }
+}
+
+__attribute__((target("avx512f"))) void memcpy_64_align_avx512(
+    void* dst, const void* src, size_t n) {
+  const __m512i* s = (const __m512i*)src;
+  __m512i* d = (__m512i*)dst;
+  // Four cache lines per iteration keep four loads in flight.
+  for (; n >= 256; n -= 256, s += 4, d += 4) {
+    __m512i zmm0 = _mm512_loadu_si512(s);
+    __m512i zmm1 = _mm512_loadu_si512(s + 1);
+    __m512i zmm2 = _mm512_loadu_si512(s + 2);
+    __m512i zmm3 = _mm512_loadu_si512(s + 3);
+    _mm512_store_si512(d, zmm0);
+    _mm512_store_si512(d + 1, zmm1);
+    _mm512_store_si512(d + 2, zmm2);
+    _mm512_store_si512(d + 3, zmm3);
+  }
+  for (; n >= 64; n -= 64, ++s, ++d) {
+    _mm512_store_si512(d, _mm512_loadu_si512(s));
+  }
+}
+
+}  // namespace enso
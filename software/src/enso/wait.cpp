@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Strategies to wait for memory written by another core or the NIC.
+ */
+
+#include <cpuid.h>
+#include <enso/wait.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include <ctime>
+
+namespace enso {
+
+bool cpu_has_waitpkg() {
+  static const bool has_waitpkg = [] {
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+      return false;
+    }
+    return (ecx & bit_WAITPKG) != 0;
+  }();
+  return has_waitpkg;
+}
+
+// Kept out of line so that the rest of the library does not need to be built
+// with WAITPKG enabled.
+__attribute__((target("waitpkg"))) static void monitor_wait(
+    const volatile uint32_t* addr, uint32_t value, uint32_t nb_cycles) {
+  _umonitor(const_cast<uint32_t*>(addr));
+
+  // The word may have changed before the monitor was armed.
+  if (*addr != value) {
+    return;
+  }
+
+  // Enter C0.2, the state that saves more power.
+  _umwait(0, __rdtsc() + nb_cycles);
+}
+
+static void park(const volatile uint32_t* addr, uint32_t value,
+                 uint32_t timeout_us) {
+  struct timespec timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = static_cast<long>(timeout_us % 1000000) * 1000;
+
+  // Not using FUTEX_PRIVATE_FLAG since the word may be shared with other
+  // processes.
+  syscall(SYS_futex, addr, FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+
+void Waiter::WaitSlow(const volatile uint32_t* addr, uint32_t value) {
+  if (nb_waits_ - strategy_.nb_spins < strategy_.nb_monitor_waits) {
+    ++nb_waits_;
+  } else if (strategy_.park) {
+    park(addr, value, strategy_.park_timeout_us);
+    return;
+  }
+
+  if (cpu_has_waitpkg()) {
+    monitor_wait(addr, value, strategy_.monitor_wait_cycles);
+  } else {
+    _mm_pause();
+  }
+}
+
+void wake_waiters(const volatile uint32_t* addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+}  // namespace enso
@@ -43,6 +43,7 @@
 #include <enso/config.h>
 #include <enso/consts.h>
 #include <enso/helpers.h>
+#include <enso/wait.h>
 #include <immintrin.h>
 #include <sched.h>
 #include <string.h>
@@ -53,6 +54,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <ctime>
@@ -60,6 +62,7 @@
 #include <iostream>
 #include <limits>
 #include <stdexcept>
+#include <vector>
 
 // Automatically points to the device backend configured at compile time.
 #include <dev_backend.h>
@@ -78,6 +81,163 @@ static _enso_always_inline void try_clflush([[maybe_unused]] void* addr) {
 #endif
 }
 
+// Initial number of slots, so that the tables of a notification buffer with
+// only a few pipes fit in a handful of cache lines.
+static constexpr uint32_t kInitialNbRxPipeSlots = 8;
+
+static struct RxPipeSlotMapEntry* __rx_pipe_slot_map_alloc(
+    uint32_t nb_entries) {
+  struct RxPipeSlotMapEntry* slot_map = (struct RxPipeSlotMapEntry*)malloc(
+      nb_entries * sizeof(struct RxPipeSlotMapEntry));
+  if (slot_map == NULL) {
+    return NULL;
+  }
+  for (uint32_t i = 0; i < nb_entries; ++i) {
+    slot_map[i].enso_pipe_id = kInvalidRxPipeSlot;
+  }
+  return slot_map;
+}
+
+static void __rx_pipe_slot_map_insert(struct RxPipeSlotMapEntry* slot_map,
+                                      uint32_t mask, uint32_t enso_pipe_id,
+                                      uint32_t slot) {
+  uint32_t i = enso_pipe_id & mask;
+  while (slot_map[i].enso_pipe_id != kInvalidRxPipeSlot) {
+    i = (i + 1) & mask;
+  }
+  slot_map[i].enso_pipe_id = enso_pipe_id;
+  slot_map[i].slot = slot;
+}
+
+int rx_pipe_slots_init(struct NotificationBufPair* notification_buf_pair) {
+  uint32_t capacity = kInitialNbRxPipeSlots;
+
+  // Keep the map at most half full so that probes stay short.
+  notification_buf_pair->rx_pipe_slot_map =
+      __rx_pipe_slot_map_alloc(capacity * 2);
+  notification_buf_pair->rx_pipe_slot_map_mask = capacity * 2 - 1;
+  notification_buf_pair->rx_pipe_slots = (struct RxPipeSlot*)calloc(
+      capacity, sizeof(*(notification_buf_pair->rx_pipe_slots)));
+  notification_buf_pair->nb_rx_pipe_slots = 0;
+  notification_buf_pair->rx_pipe_slots_capacity = capacity;
+  notification_buf_pair->free_rx_pipe_slots.clear();
+
+  if (notification_buf_pair->rx_pipe_slot_map == NULL ||
+      notification_buf_pair->rx_pipe_slots == NULL) {
+    std::cerr << "Could not allocate memory" << std::endl;
+    rx_pipe_slots_free(notification_buf_pair);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Doubles the number of slots, rehashing the map.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int __rx_pipe_slots_grow(
+    struct NotificationBufPair* notification_buf_pair) {
+  uint32_t capacity = notification_buf_pair->rx_pipe_slots_capacity * 2;
+
+  struct RxPipeSlot* rx_pipe_slots =
+      (struct RxPipeSlot*)realloc(notification_buf_pair->rx_pipe_slots,
+                                  capacity * sizeof(*rx_pipe_slots));
+  if (rx_pipe_slots == NULL) {
+    return -1;
+  }
+  notification_buf_pair->rx_pipe_slots = rx_pipe_slots;
+
+  struct RxPipeSlotMapEntry* slot_map = __rx_pipe_slot_map_alloc(capacity * 2);
+  if (slot_map == NULL) {
+    return -1;
+  }
+  struct RxPipeSlotMapEntry* old_slot_map =
+      notification_buf_pair->rx_pipe_slot_map;
+  uint32_t old_mask = notification_buf_pair->rx_pipe_slot_map_mask;
+  uint32_t mask = capacity * 2 - 1;
+  for (uint32_t i = 0; i <= old_mask; ++i) {
+    if (old_slot_map[i].enso_pipe_id != kInvalidRxPipeSlot) {
+      __rx_pipe_slot_map_insert(slot_map, mask, old_slot_map[i].enso_pipe_id,
+                                old_slot_map[i].slot);
+    }
+  }
+  free(old_slot_map);
+
+  notification_buf_pair->rx_pipe_slot_map = slot_map;
+  notification_buf_pair->rx_pipe_slot_map_mask = mask;
+  notification_buf_pair->rx_pipe_slots_capacity = capacity;
+  return 0;
+}
+
+int32_t assign_rx_pipe_slot(struct NotificationBufPair* notification_buf_pair,
+                            enso_pipe_id_t enso_pipe_id) {
+  uint32_t slot = get_rx_pipe_slot(notification_buf_pair, enso_pipe_id);
+  if (slot != kInvalidRxPipeSlot) {
+    return slot;
+  }
+
+  std::vector<uint32_t>& free_slots = notification_buf_pair->free_rx_pipe_slots;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  } else {
+    if (notification_buf_pair->nb_rx_pipe_slots ==
+            notification_buf_pair->rx_pipe_slots_capacity &&
+        __rx_pipe_slots_grow(notification_buf_pair)) {
+      std::cerr << "Could not allocate memory" << std::endl;
+      return -1;
+    }
+    slot = notification_buf_pair->nb_rx_pipe_slots++;
+  }
+
+  __rx_pipe_slot_map_insert(notification_buf_pair->rx_pipe_slot_map,
+                            notification_buf_pair->rx_pipe_slot_map_mask,
+                            enso_pipe_id, slot);
+  notification_buf_pair->rx_pipe_slots[slot].pending_tail = 0;
+  notification_buf_pair->rx_pipe_slots[slot].notif_gen = 0;
+  return slot;
+}
+
+void release_rx_pipe_slot(struct NotificationBufPair* notification_buf_pair,
+                          enso_pipe_id_t enso_pipe_id) {
+  struct RxPipeSlotMapEntry* slot_map = notification_buf_pair->rx_pipe_slot_map;
+  uint32_t mask = notification_buf_pair->rx_pipe_slot_map_mask;
+
+  uint32_t i = enso_pipe_id & mask;
+  while (slot_map[i].enso_pipe_id != enso_pipe_id) {
+    if (slot_map[i].enso_pipe_id == kInvalidRxPipeSlot) {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  notification_buf_pair->free_rx_pipe_slots.push_back(slot_map[i].slot);
+
+  // Shift back the entries that come after the removed one in the same probe
+  // sequence, so that lookups never stop early at the hole.
+  uint32_t j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (slot_map[j].enso_pipe_id == kInvalidRxPipeSlot) {
+      break;
+    }
+    uint32_t home = slot_map[j].enso_pipe_id & mask;
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      slot_map[i] = slot_map[j];
+      i = j;
+    }
+  }
+  slot_map[i].enso_pipe_id = kInvalidRxPipeSlot;
+}
+
+void rx_pipe_slots_free(struct NotificationBufPair* notification_buf_pair) {
+  free(notification_buf_pair->rx_pipe_slot_map);
+  free(notification_buf_pair->rx_pipe_slots);
+  notification_buf_pair->rx_pipe_slot_map = NULL;
+  notification_buf_pair->rx_pipe_slots = NULL;
+  notification_buf_pair->free_rx_pipe_slots.clear();
+}
+
 int notification_buf_init(uint32_t bdf, int32_t bar,
                           struct NotificationBufPair* notification_buf_pair,
                           const std::string& huge_page_prefix,
@@ -181,18 +341,18 @@ int notification_buf_init(uint32_t bdf, int32_t bar,
                               notification_buf_pair->uio_mmap_bar2_addr);
 
   notification_buf_pair->tx_head = notification_buf_pair->tx_tail;
+  notification_buf_pair->tx_tail_reported = notification_buf_pair->tx_tail;
+  notification_buf_pair->tx_tail_flush_threshold = 0;
 
   DevBackend::mmio_write32(&notification_buf_pair_regs->tx_head,
                            notification_buf_pair->tx_head,
                            notification_buf_pair->uio_mmap_bar2_addr);
 
-  notification_buf_pair->pending_rx_pipe_tails = (uint32_t*)malloc(
-      sizeof(*(notification_buf_pair->pending_rx_pipe_tails)) * kMaxNbFlows);
-  if (notification_buf_pair->pending_rx_pipe_tails == NULL) {
-    std::cerr << "Could not allocate memory" << std::endl;
+  if (rx_pipe_slots_init(notification_buf_pair)) {
     return -1;
   }
-  memset(notification_buf_pair->pending_rx_pipe_tails, 0, kMaxNbFlows);
+  notification_buf_pair->notif_gen = 0;
+  notification_buf_pair->coalesce_notifs = false;
 
   notification_buf_pair->wrap_tracker =
       (uint8_t*)malloc(kNotificationBufSize / 8);
@@ -203,7 +363,7 @@ int notification_buf_init(uint32_t bdf, int32_t bar,
   memset(notification_buf_pair->wrap_tracker, 0, kNotificationBufSize / 8);
 
   notification_buf_pair->next_rx_pipe_notifs =
-      (RxNotification**)malloc(kNotificationBufSize * sizeof(RxNotification*));
+      (RxNotification**)malloc(kNextRxNotifsSize * sizeof(RxNotification*));
   if (notification_buf_pair->next_rx_pipe_notifs == NULL) {
     std::cerr << "Could not allocate memory" << std::endl;
     return -1;
@@ -216,6 +376,20 @@ int notification_buf_init(uint32_t bdf, int32_t bar,
   notification_buf_pair->nb_unreported_completions = 0;
   notification_buf_pair->huge_page_prefix = huge_page_prefix;
 
+  // All pipe buffers for this notification buffer come from the same file.
+  notification_buf_pair->pipe_buf_arena = new (std::nothrow) HugePageArena();
+  if (notification_buf_pair->pipe_buf_arena == nullptr) {
+    std::cerr << "Could not allocate memory" << std::endl;
+    return -1;
+  }
+  std::string arena_path = huge_page_prefix +
+                           std::string(kHugePagePipeArenaPathPrefix) +
+                           std::to_string(notification_buf_pair->id);
+  if (huge_page_arena_init(notification_buf_pair->pipe_buf_arena,
+                           arena_path)) {
+    return -1;
+  }
+
   // Setting the address enables the queue. Do this last.
   // Use first half of the huge page for RX and second half for TX.
   DevBackend::mmio_write32(&notification_buf_pair_regs->rx_mem_low,
@@ -236,21 +410,14 @@ int notification_buf_init(uint32_t bdf, int32_t bar,
   return 0;
 }
 
-int enso_pipe_init(struct RxEnsoPipeInternal* enso_pipe,
-                   struct NotificationBufPair* notification_buf_pair,
-                   bool fallback) {
+/**
+ * @brief Disables the pipe and resets its head and tail. Does not wait for the
+ *        writes to take effect, use `__enso_pipe_wait_reset` for that.
+ */
+static _enso_always_inline void __enso_pipe_reset(
+    struct RxEnsoPipeInternal* enso_pipe,
+    struct NotificationBufPair* notification_buf_pair, int enso_pipe_id) {
   void* uio_mmap_bar2_addr = notification_buf_pair->uio_mmap_bar2_addr;
-  DevBackend* fpga_dev =
-      static_cast<DevBackend*>(notification_buf_pair->fpga_dev);
-
-  if (lock_runtime_) std::invoke(lock_runtime_);
-  int enso_pipe_id = fpga_dev->AllocatePipe(fallback);
-  if (unlock_runtime_) std::invoke(unlock_runtime_);
-
-  if (enso_pipe_id < 0) {
-    std::cerr << "Could not allocate pipe" << std::endl;
-    return -1;
-  }
 
   // Register associated with the enso pipe.
   volatile struct QueueRegs* enso_pipe_regs =
@@ -258,42 +425,114 @@ int enso_pipe_init(struct RxEnsoPipeInternal* enso_pipe,
                           enso_pipe_id * kMemorySpacePerQueue);
   enso_pipe->regs = (struct QueueRegs*)enso_pipe_regs;
   enso_pipe->uio_mmap_bar2_addr = uio_mmap_bar2_addr;
+  enso_pipe->id = enso_pipe_id;
+  enso_pipe->slot = kInvalidRxPipeSlot;
+  enso_pipe->buf = nullptr;
+
   // Make sure the queue is disabled.
-  DevBackend::mmio_write32(&enso_pipe_regs->rx_mem_low, 0,
-                           notification_buf_pair->uio_mmap_bar2_addr);
+  DevBackend::mmio_write32(&enso_pipe_regs->rx_mem_low, 0, uio_mmap_bar2_addr);
   DevBackend::mmio_write32(&enso_pipe_regs->rx_mem_high, 0,
-                           notification_buf_pair->uio_mmap_bar2_addr);
+                           uio_mmap_bar2_addr);
 
+  // Make sure head and tail start at zero.
+  DevBackend::mmio_write32(&enso_pipe_regs->rx_tail, 0, uio_mmap_bar2_addr);
+  DevBackend::mmio_write32(&enso_pipe_regs->rx_head, 0, uio_mmap_bar2_addr);
+}
+
+/**
+ * @brief Waits until the writes from `__enso_pipe_reset` take effect.
+ */
+static _enso_always_inline void __enso_pipe_wait_reset(
+    struct RxEnsoPipeInternal* enso_pipe, void* uio_mmap_bar2_addr) {
+  volatile struct QueueRegs* enso_pipe_regs = enso_pipe->regs;
   uint64_t mask = (1L << 32L) - 1L;
   while ((DevBackend::mmio_read32(&enso_pipe_regs->rx_mem_low,
-                                  notification_buf_pair->uio_mmap_bar2_addr) &
+                                  uio_mmap_bar2_addr) &
           (~mask)) != 0 ||
          DevBackend::mmio_read32(&enso_pipe_regs->rx_mem_high,
-                                 notification_buf_pair->uio_mmap_bar2_addr) !=
-             0) {
+                                 uio_mmap_bar2_addr) != 0) {
     continue;
   }
 
-  // Make sure head and tail start at zero.
-  DevBackend::mmio_write32(&enso_pipe_regs->rx_tail, 0,
-                           notification_buf_pair->uio_mmap_bar2_addr);
   while (DevBackend::mmio_read32(&enso_pipe_regs->rx_tail,
-                                 notification_buf_pair->uio_mmap_bar2_addr) !=
-         0)
+                                 uio_mmap_bar2_addr) != 0)
     continue;
 
-  DevBackend::mmio_write32(&enso_pipe_regs->rx_head, 0,
-                           notification_buf_pair->uio_mmap_bar2_addr);
   while (DevBackend::mmio_read32(&enso_pipe_regs->rx_head,
-                                 notification_buf_pair->uio_mmap_bar2_addr) !=
-         0)
+                                 uio_mmap_bar2_addr) != 0)
     continue;
+}
 
-  std::string huge_page_path = notification_buf_pair->huge_page_prefix +
-                               std::string(kHugePageRxPipePathPrefix) +
-                               std::to_string(enso_pipe_id);
+/**
+ * @brief Allocates a mirrored buffer for a pipe of `nb_flits` flits.
+ *
+ * Pipes with the default size come from the notification buffer's arena. Larger
+ * pipes get their own huge pages and smaller ones use regular pages. Regular
+ * pages are not physically contiguous, so smaller pipes are only supported by
+ * backends that use virtual addresses as device addresses.
+ */
+static uint32_t* __enso_pipe_alloc_buf(
+    struct RxEnsoPipeInternal* enso_pipe,
+    struct NotificationBufPair* notification_buf_pair, uint32_t nb_flits) {
+  size_t size = (size_t)nb_flits * 64;
+  if (size == kBufPageSize) {
+    return (uint32_t*)huge_page_arena_alloc(
+        notification_buf_pair->pipe_buf_arena);
+  }
+
+  if (size < kBufPageSize) {
+    if (!DevBackend::kDevAddrIsVirtAddr) {
+      std::cerr << "Pipes smaller than " << kBufPageSize
+                << " bytes are not supported by the device" << std::endl;
+      return nullptr;
+    }
+    return (uint32_t*)get_mirrored_buf(size);
+  }
+
+  std::string path = notification_buf_pair->huge_page_prefix +
+                     std::string(kHugePageRxPipePathPrefix) +
+                     std::to_string(enso_pipe->id);
+  void* buf = get_huge_page(path, size, true);
 
-  enso_pipe->buf = (uint32_t*)get_huge_page(huge_page_path, 0, true);
+  // The mapping keeps the huge pages alive.
+  unlink(path.c_str());
+  return (uint32_t*)buf;
+}
+
+static void __enso_pipe_free_buf(
+    struct RxEnsoPipeInternal* enso_pipe,
+    struct NotificationBufPair* notification_buf_pair) {
+  size_t size = ((size_t)enso_pipe->mask + 1) * 64;
+  if (size == kBufPageSize) {
+    huge_page_arena_free(notification_buf_pair->pipe_buf_arena,
+                         enso_pipe->buf);
+  } else {
+    free_mirrored_buf(enso_pipe->buf, size);
+  }
+  enso_pipe->buf = nullptr;
+}
+
+/**
+ * @brief Maps the buffer for a pipe that was reset and enables it.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int __enso_pipe_enable(struct RxEnsoPipeInternal* enso_pipe,
+                              struct NotificationBufPair* notification_buf_pair,
+                              uint32_t nb_flits) {
+  DevBackend* fpga_dev =
+      static_cast<DevBackend*>(notification_buf_pair->fpga_dev);
+  volatile struct QueueRegs* enso_pipe_regs = enso_pipe->regs;
+
+  if (fpga_dev->SetPipeSize(enso_pipe->id, nb_flits)) {
+    std::cerr << "Pipe size not supported by the device: " << nb_flits
+              << " flits" << std::endl;
+    return -1;
+  }
+  enso_pipe->mask = nb_flits - 1;
+
+  enso_pipe->buf =
+      __enso_pipe_alloc_buf(enso_pipe, notification_buf_pair, nb_flits);
   if (enso_pipe->buf == NULL) {
     std::cerr << "Could not get huge page" << std::endl;
     return -1;
@@ -303,15 +542,21 @@ int enso_pipe_init(struct RxEnsoPipeInternal* enso_pipe,
   enso_pipe->buf_phys_addr = phys_addr;
   enso_pipe->phys_buf_offset = phys_addr - (uint64_t)(enso_pipe->buf);
 
-  enso_pipe->id = enso_pipe_id;
   enso_pipe->buf_head_ptr = (uint32_t*)&enso_pipe_regs->rx_head;
   enso_pipe->rx_head = 0;
   enso_pipe->rx_tail = 0;
-  enso_pipe->huge_page_prefix = notification_buf_pair->huge_page_prefix;
+  enso_pipe->last_reported_head = 0;
+  enso_pipe->head_update_threshold = 0;
+
+  int32_t slot = assign_rx_pipe_slot(notification_buf_pair, enso_pipe->id);
+  if (slot < 0) {
+    __enso_pipe_free_buf(enso_pipe, notification_buf_pair);
+    return -1;
+  }
+  enso_pipe->slot = slot;
 
   // Make sure the last tail matches the current head.
-  notification_buf_pair->pending_rx_pipe_tails[enso_pipe->id] =
-      enso_pipe->rx_head;
+  notification_buf_pair->rx_pipe_slots[slot].pending_tail = enso_pipe->rx_head;
 
   // Setting the address enables the queue. Do this last.
   // The least significant bits in rx_mem_low are used to keep the notification
@@ -322,10 +567,92 @@ int enso_pipe_init(struct RxEnsoPipeInternal* enso_pipe,
   DevBackend::mmio_write32(&enso_pipe_regs->rx_mem_high,
                            (uint32_t)(phys_addr >> 32),
                            notification_buf_pair->uio_mmap_bar2_addr);
+  return 0;
+}
+
+int enso_pipe_init(struct RxEnsoPipeInternal* enso_pipe,
+                   struct NotificationBufPair* notification_buf_pair,
+                   bool fallback, uint32_t nb_flits) {
+  DevBackend* fpga_dev =
+      static_cast<DevBackend*>(notification_buf_pair->fpga_dev);
+
+  if (nb_flits < kMinEnsoPipeSize || nb_flits > kMaxEnsoPipeSize ||
+      (nb_flits & (nb_flits - 1)) != 0) {
+    std::cerr << "Pipe size must be a power of two between "
+              << kMinEnsoPipeSize << " and " << kMaxEnsoPipeSize << " flits"
+              << std::endl;
+    return -1;
+  }
+
+  if (lock_runtime_) std::invoke(lock_runtime_);
+  int enso_pipe_id = fpga_dev->AllocatePipe(fallback);
+  if (unlock_runtime_) std::invoke(unlock_runtime_);
+
+  if (enso_pipe_id < 0) {
+    std::cerr << "Could not allocate pipe" << std::endl;
+    return -1;
+  }
+
+  __enso_pipe_reset(enso_pipe, notification_buf_pair, enso_pipe_id);
+  __enso_pipe_wait_reset(enso_pipe, notification_buf_pair->uio_mmap_bar2_addr);
+
+  if (__enso_pipe_enable(enso_pipe, notification_buf_pair, nb_flits)) {
+    return -1;
+  }
+
   update_fallback_queues_config(notification_buf_pair);
   return enso_pipe_id;
 }
 
+int enso_pipes_init(struct RxEnsoPipeInternal** enso_pipes, uint32_t nb_pipes,
+                    struct NotificationBufPair* notification_buf_pair,
+                    bool fallback) {
+  DevBackend* fpga_dev =
+      static_cast<DevBackend*>(notification_buf_pair->fpga_dev);
+  void* uio_mmap_bar2_addr = notification_buf_pair->uio_mmap_bar2_addr;
+
+  std::vector<int> enso_pipe_ids(nb_pipes);
+
+  if (lock_runtime_) std::invoke(lock_runtime_);
+  uint32_t nb_allocated = 0;
+  for (; nb_allocated < nb_pipes; ++nb_allocated) {
+    int enso_pipe_id = fpga_dev->AllocatePipe(fallback);
+    if (enso_pipe_id < 0) {
+      break;
+    }
+    enso_pipe_ids[nb_allocated] = enso_pipe_id;
+  }
+  if (unlock_runtime_) std::invoke(unlock_runtime_);
+
+  if (nb_allocated < nb_pipes) {
+    std::cerr << "Could not allocate pipe" << std::endl;
+    for (uint32_t i = 0; i < nb_allocated; ++i) {
+      fpga_dev->FreePipe(enso_pipe_ids[i]);
+    }
+    return -1;
+  }
+
+  // Issue the resets for all pipes before waiting for any of them, so that we
+  // wait for the register round trips only once.
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    __enso_pipe_reset(enso_pipes[i], notification_buf_pair, enso_pipe_ids[i]);
+  }
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    __enso_pipe_wait_reset(enso_pipes[i], uio_mmap_bar2_addr);
+  }
+
+  for (uint32_t i = 0; i < nb_pipes; ++i) {
+    if (__enso_pipe_enable(enso_pipes[i], notification_buf_pair,
+                           kEnsoPipeSize)) {
+      return -1;
+    }
+  }
+
+  // A single configuration update for all the pipes.
+  update_fallback_queues_config(notification_buf_pair);
+  return 0;
+}
+
 int dma_init(struct NotificationBufPair* notification_buf_pair,
              struct RxEnsoPipeInternal* enso_pipe, uint32_t bdf, int32_t bar,
              const std::string& huge_page_prefix, bool fallback) {
@@ -349,123 +676,35 @@ int dma_init(struct NotificationBufPair* notification_buf_pair,
 
   ++(notification_buf_pair->ref_cnt);
 
-  return enso_pipe_init(enso_pipe, notification_buf_pair, fallback);
-}
-
-/**
- * @brief Updates bookkeeping on until where packets are
- *        available for each enso RX pipe, adds to ring buffer with
- *        next notifications to consume.
- *
- * @param notification_buf_pair
- * @return Number of consumed notifications.
- */
-static _enso_always_inline uint16_t
-__get_new_tails(struct NotificationBufPair* notification_buf_pair,
-                UpdatePacket update_packet) {
-  struct RxNotification* notification_buf = notification_buf_pair->rx_buf;
-  uint32_t notification_buf_head = notification_buf_pair->rx_head;
-  uint16_t nb_consumed_notifications = 0;
-
-  uint16_t next_rx_ids_tail = notification_buf_pair->next_rx_ids_tail;
-
-  for (uint16_t i = 0; i < kBatchSize; ++i) {
-    struct RxNotification* cur_notification =
-        notification_buf + notification_buf_head;
-
-    // Check if the next notification was updated by the NIC.
-    if (!cur_notification->signal) {
-      break;
-    }
-
-    enso_pipe_id_t enso_pipe_id = cur_notification->queue_id;
-
-    /* Update the packet sent time in the packet itself */
-    if (update_packet) {
-      std::invoke(update_packet, enso_pipe_id,
-                  (uint64_t)cur_notification->pad[1],
-                  notification_buf_pair->pending_rx_pipe_tails[enso_pipe_id]);
-    }
-
-    cur_notification->signal = 0;
-
-    notification_buf_head = (notification_buf_head + 1) % kNotificationBufSize;
-
-    /* Must update the corresponding packet in the RX Pipe with the sent time
-     * timestamp */
-
-    notification_buf_pair->pending_rx_pipe_tails[enso_pipe_id] =
-        (uint32_t)cur_notification->tail;
-
-    // orders the new updates: read pipes from next_rx_ids_head to
-    // next_rx_ids_tail
-    notification_buf_pair->next_rx_pipe_notifs[next_rx_ids_tail] =
-        cur_notification;
-    next_rx_ids_tail = (next_rx_ids_tail + 1) % kNotificationBufSize;
-
-    ++nb_consumed_notifications;
-  }
-
-  notification_buf_pair->next_rx_ids_tail = next_rx_ids_tail;
-
-  if (likely(nb_consumed_notifications > 0)) {
-    DevBackend::mmio_write32(notification_buf_pair->rx_head_ptr,
-                             notification_buf_head,
-                             notification_buf_pair->uio_mmap_bar2_addr);
-    notification_buf_pair->rx_head = notification_buf_head;
-  }
-
-  return nb_consumed_notifications;
+  return enso_pipe_init(enso_pipe, notification_buf_pair, fallback,
+                        kEnsoPipeSize);
 }
 
 uint16_t get_new_tails(struct NotificationBufPair* notification_buf_pair,
                        UpdatePacket update_packet) {
-  return __get_new_tails(notification_buf_pair, update_packet);
-}
-
-static _enso_always_inline uint32_t
-__consume_queue(struct RxEnsoPipeInternal* enso_pipe,
-                struct NotificationBufPair* notification_buf_pair, void** buf,
-                bool peek = false) {
-  uint32_t* enso_pipe_buf = enso_pipe->buf;
-  uint32_t enso_pipe_head = enso_pipe->rx_tail;
-  int queue_id = enso_pipe->id;
-
-  *buf = &enso_pipe_buf[enso_pipe_head * 16];
-
-  uint32_t enso_pipe_tail =
-      notification_buf_pair->pending_rx_pipe_tails[queue_id];
-
-  if (enso_pipe_tail == enso_pipe_head) {
-    return 0;
+  if (update_packet) {
+    return fast_path::get_new_tails<DevBackend>(notification_buf_pair,
+                                                update_packet);
   }
-
-  uint32_t flit_aligned_size =
-      ((enso_pipe_tail - enso_pipe_head) % ENSO_PIPE_SIZE) * 64;
-
-  if (!peek) {
-    enso_pipe_head = (enso_pipe_head + flit_aligned_size / 64) % ENSO_PIPE_SIZE;
-    enso_pipe->rx_tail = enso_pipe_head;
-  }
-
-  return flit_aligned_size;
+  return fast_path::get_new_tails<DevBackend>(notification_buf_pair);
 }
 
 uint32_t get_next_batch_from_queue(
     struct RxEnsoPipeInternal* enso_pipe,
     struct NotificationBufPair* notification_buf_pair, void** buf) {
-  return __consume_queue(enso_pipe, notification_buf_pair, buf);
+  return fast_path::consume_queue(enso_pipe, notification_buf_pair, buf);
 }
 
 uint32_t peek_next_batch_from_queue(
     struct RxEnsoPipeInternal* enso_pipe,
     struct NotificationBufPair* notification_buf_pair, void** buf) {
-  return __consume_queue(enso_pipe, notification_buf_pair, buf, true);
+  return fast_path::consume_queue(enso_pipe, notification_buf_pair, buf, true);
 }
 
+template <typename UpdateFn = fast_path::NoUpdatePacket>
 static _enso_always_inline struct RxNotification* __get_next_rx_notif(
     struct NotificationBufPair* notification_buf_pair,
-    UpdatePacket update_packet) {
+    const UpdateFn& update_packet = UpdateFn()) {
   // Consume up to a batch of notifications at a time. If the number of consumed
   // notifications is the same as the number of pending notifications, we are
   // done processing the last batch and can get the next one. Using batches here
@@ -476,7 +715,8 @@ static _enso_always_inline struct RxNotification* __get_next_rx_notif(
 
   if (next_rx_ids_head == next_rx_ids_tail) {
     uint16_t nb_consumed_notifications =
-        __get_new_tails(notification_buf_pair, update_packet);
+        fast_path::get_new_tails<DevBackend>(notification_buf_pair,
+                                             update_packet);
     if (unlikely(nb_consumed_notifications == 0)) {
       return nullptr;
     }
@@ -486,7 +726,7 @@ static _enso_always_inline struct RxNotification* __get_next_rx_notif(
       notification_buf_pair->next_rx_pipe_notifs[next_rx_ids_head];
 
   notification_buf_pair->next_rx_ids_head =
-      (next_rx_ids_head + 1) % kNotificationBufSize;
+      (next_rx_ids_head + 1) % kNextRxNotifsSize;
 
   return notification;
 }
@@ -494,7 +734,10 @@ static _enso_always_inline struct RxNotification* __get_next_rx_notif(
 struct RxNotification* get_next_rx_notif(
     struct NotificationBufPair* notification_buf_pair,
     UpdatePacket update_packet) {
-  return __get_next_rx_notif(notification_buf_pair, update_packet);
+  if (update_packet) {
+    return __get_next_rx_notif(notification_buf_pair, update_packet);
+  }
+  return __get_next_rx_notif(notification_buf_pair);
 }
 
 static _enso_always_inline int32_t
@@ -513,7 +756,7 @@ int32_t get_next_enso_pipe_id(
 uint32_t get_next_batch(struct NotificationBufPair* notification_buf_pair,
                         struct SocketInternal* socket_entries,
                         int* enso_pipe_id, void** buf) {
-  RxNotification* notif = __get_next_rx_notif(notification_buf_pair, NULL);
+  RxNotification* notif = __get_next_rx_notif(notification_buf_pair);
 
   if (unlikely(!notif)) {
     return 0;
@@ -526,89 +769,98 @@ uint32_t get_next_batch(struct NotificationBufPair* notification_buf_pair,
   struct SocketInternal* socket_entry = &socket_entries[__enso_pipe_id];
   struct RxEnsoPipeInternal* enso_pipe = &socket_entry->enso_pipe;
 
-  return __consume_queue(enso_pipe, notification_buf_pair, buf);
+  return fast_path::consume_queue(enso_pipe, notification_buf_pair, buf);
 }
 
 void advance_pipe(struct RxEnsoPipeInternal* enso_pipe, size_t len) {
-  uint32_t rx_pkt_head = enso_pipe->rx_head;
-  uint32_t nb_flits = ((uint64_t)len - 1) / 64 + 1;
-  rx_pkt_head = (rx_pkt_head + nb_flits) % ENSO_PIPE_SIZE;
-
-  DevBackend::mmio_write32(enso_pipe->buf_head_ptr, rx_pkt_head,
-                           enso_pipe->uio_mmap_bar2_addr);
-  enso_pipe->rx_head = rx_pkt_head;
+  fast_path::advance_pipe<DevBackend>(enso_pipe, len);
 }
 
 void fully_advance_pipe(struct RxEnsoPipeInternal* enso_pipe) {
-  DevBackend::mmio_write32(enso_pipe->buf_head_ptr, enso_pipe->rx_tail,
-                           enso_pipe->uio_mmap_bar2_addr);
-  enso_pipe->rx_head = enso_pipe->rx_tail;
+  fast_path::fully_advance_pipe<DevBackend>(enso_pipe);
 }
 
-void prefetch_pipe(struct RxEnsoPipeInternal* enso_pipe) {
-  DevBackend::mmio_write32(enso_pipe->buf_head_ptr, enso_pipe->rx_head,
-                           enso_pipe->uio_mmap_bar2_addr);
+void flush_pipe_head(struct RxEnsoPipeInternal* enso_pipe) {
+  if (enso_pipe->rx_head != enso_pipe->last_reported_head) {
+    fast_path::report_pipe_head<DevBackend>(enso_pipe);
+  }
 }
 
-static _enso_always_inline uint32_t
-__send_to_queue(struct NotificationBufPair* notification_buf_pair,
-                uint64_t phys_addr, uint32_t len, uint64_t sent_time) {
-  struct TxNotification* tx_buf = notification_buf_pair->tx_buf;
-  uint32_t tx_tail = notification_buf_pair->tx_tail;
-  uint32_t missing_bytes = len;
-
-  uint64_t transf_addr = phys_addr;
-  uint64_t hugepage_mask = ~((uint64_t)kBufPageSize - 1);
-  uint64_t hugepage_base_addr = transf_addr & hugepage_mask;
-  uint64_t hugepage_boundary = hugepage_base_addr + kBufPageSize;
-
-  while (missing_bytes > 0) {
-    uint32_t free_slots =
-        (notification_buf_pair->tx_head - tx_tail - 1) % kNotificationBufSize;
+int set_pipe_head_update_threshold(struct RxEnsoPipeInternal* enso_pipe,
+                                   uint32_t nb_flits) {
+  uint32_t max_threshold = (enso_pipe->mask + 1) / 2;
+  if (nb_flits > max_threshold) {
+    std::cerr << "Head update threshold must be at most " << max_threshold
+              << " flits" << std::endl;
+    return -1;
+  }
+  enso_pipe->head_update_threshold = nb_flits;
 
-    // Block until we can send.
-    while (unlikely(free_slots == 0)) {
-      ++notification_buf_pair->tx_full_cnt;
-      if (park_callback_ != nullptr) {
-        std::invoke(park_callback_);
-      }
-      update_tx_head(notification_buf_pair);
-      free_slots =
-          (notification_buf_pair->tx_head - tx_tail - 1) % kNotificationBufSize;
-    }
+  // Make sure we do not keep freed space hidden from the NIC.
+  flush_pipe_head(enso_pipe);
+  return 0;
+}
 
-    struct TxNotification* tx_notification = tx_buf + tx_tail;
-    uint32_t req_length = std::min(missing_bytes, (uint32_t)kMaxTransferLen);
-    uint32_t missing_bytes_in_page = hugepage_boundary - transf_addr;
-    req_length = std::min(req_length, missing_bytes_in_page);
+void prefetch_pipe(struct RxEnsoPipeInternal* enso_pipe) {
+  fast_path::report_pipe_head<DevBackend>(enso_pipe);
+}
 
-    // If the transmission needs to be split among multiple requests, we
-    // need to set a bit in the wrap tracker.
-    uint8_t wrap_tracker_mask = (missing_bytes > req_length) << (tx_tail & 0x7);
-    notification_buf_pair->wrap_tracker[tx_tail / 8] |= wrap_tracker_mask;
+void fast_path::library_mmio_write32(volatile uint32_t* addr, uint32_t value,
+                                     void* uio_mmap_bar2_addr) {
+  DevBackend::mmio_write32(addr, value, uio_mmap_bar2_addr);
+}
 
-    tx_notification->length = req_length;
-    tx_notification->phys_addr = transf_addr;
-    tx_notification->pad[0] = sent_time;
-    tx_notification->signal = 1;
+void fast_path::CallbackPark::park() {
+  if (park_callback_ != nullptr) {
+    std::invoke(park_callback_);
+  }
+}
 
-    uint64_t huge_page_offset = (transf_addr + req_length) % kBufPageSize;
-    transf_addr = hugepage_base_addr + huge_page_offset;
+uint32_t send_to_queue(struct NotificationBufPair* notification_buf_pair,
+                       uint64_t phys_addr, uint32_t len, uint64_t sent_time) {
+  return fast_path::send_to_queue<DevBackend>(notification_buf_pair, phys_addr,
+                                              len, sent_time);
+}
 
-    tx_tail = (tx_tail + 1) % kNotificationBufSize;
-    missing_bytes -= req_length;
+uint32_t try_send_to_queue(struct NotificationBufPair* notification_buf_pair,
+                           uint64_t phys_addr, uint32_t len,
+                           uint64_t sent_time) {
+  // A request is split at every `kMaxTransferLen` bytes and at the end of the
+  // huge page, so this is an upper bound on the notifications it needs.
+  uint32_t max_nb_notifs = len / kMaxTransferLen + 2;
+
+  uint32_t free_slots = (notification_buf_pair->tx_head -
+                         notification_buf_pair->tx_tail - 1) %
+                        kNotificationBufSize;
+  if (free_slots < max_nb_notifs) {
+    fast_path::flush_tx<DevBackend>(notification_buf_pair);
+    update_tx_head(notification_buf_pair);
+    free_slots = (notification_buf_pair->tx_head -
+                  notification_buf_pair->tx_tail - 1) %
+                 kNotificationBufSize;
+    if (free_slots < max_nb_notifs) {
+      return 0;
+    }
   }
 
-  notification_buf_pair->tx_tail = tx_tail;
-  DevBackend::mmio_write32(notification_buf_pair->tx_tail_ptr, tx_tail,
-                           notification_buf_pair->uio_mmap_bar2_addr);
+  return fast_path::send_to_queue<DevBackend>(notification_buf_pair, phys_addr,
+                                              len, sent_time);
+}
 
-  return len;
+void flush_tx(struct NotificationBufPair* notification_buf_pair) {
+  fast_path::flush_tx<DevBackend>(notification_buf_pair);
 }
 
-uint32_t send_to_queue(struct NotificationBufPair* notification_buf_pair,
-                       uint64_t phys_addr, uint32_t len, uint64_t sent_time) {
-  return __send_to_queue(notification_buf_pair, phys_addr, len, sent_time);
+int set_tx_flush_threshold(struct NotificationBufPair* notification_buf_pair,
+                           uint32_t nb_notifications) {
+  if (nb_notifications > kMaxTxFlushThreshold) {
+    std::cerr << "TX flush threshold must be at most " << kMaxTxFlushThreshold
+              << " notifications" << std::endl;
+    return -1;
+  }
+  notification_buf_pair->tx_tail_flush_threshold = nb_notifications;
+  fast_path::flush_tx<DevBackend>(notification_buf_pair);
+  return 0;
 }
 
 uint32_t get_unreported_completions(
@@ -660,6 +912,30 @@ void update_tx_head(struct NotificationBufPair* notification_buf_pair) {
   notification_buf_pair->tx_head = head;
 }
 
+/**
+ * @brief Waits for the NIC to consume the TX notification at the head.
+ *
+ * Threads with a park callback yield to it instead, since they may share the
+ * core with other threads.
+ */
+static void wait_for_tx_head(struct NotificationBufPair* notification_buf_pair,
+                             Waiter* waiter) {
+  if (park_callback_ != nullptr) {
+    std::invoke(park_callback_);
+    return;
+  }
+
+  // Notifications are cache-line aligned, so the low half of the signal (the
+  // first field) is safe to watch as a word.
+  void* tx_notification =
+      notification_buf_pair->tx_buf + notification_buf_pair->tx_head;
+  volatile uint32_t* signal = static_cast<volatile uint32_t*>(tx_notification);
+  uint32_t pending_signal = *signal;
+  if (pending_signal != 0) {
+    waiter->Wait(signal, pending_signal);
+  }
+}
+
 int send_config(struct NotificationBufPair* notification_buf_pair,
                 struct TxNotification* config_notification,
                 CompletionCallback* completion_callback) {
@@ -673,14 +949,16 @@ int send_config(struct NotificationBufPair* notification_buf_pair,
   }
 
   // Block until we can send.
+  Waiter waiter;
+  if (unlikely(free_slots == 0)) {
+    fast_path::flush_tx<DevBackend>(notification_buf_pair);
+  }
   while (unlikely(free_slots == 0)) {
     ++notification_buf_pair->tx_full_cnt;
     update_tx_head(notification_buf_pair);
     free_slots =
         (notification_buf_pair->tx_head - tx_tail - 1) % kNotificationBufSize;
-    if (park_callback_ != nullptr) {
-      std::invoke(park_callback_);
-    }
+    wait_for_tx_head(notification_buf_pair, &waiter);
   }
 
   struct TxNotification* tx_notification = tx_buf + tx_tail;
@@ -688,17 +966,17 @@ int send_config(struct NotificationBufPair* notification_buf_pair,
 
   tx_tail = (tx_tail + 1) % kNotificationBufSize;
   notification_buf_pair->tx_tail = tx_tail;
-  DevBackend::mmio_write32(notification_buf_pair->tx_tail_ptr, tx_tail,
-                           notification_buf_pair->uio_mmap_bar2_addr);
+
+  // Config notifications are always sent right away, together with any
+  // deferred notifications before them.
+  fast_path::flush_tx<DevBackend>(notification_buf_pair);
 
   // Wait for request to be consumed.
   uint32_t nb_unreported_completions =
       notification_buf_pair->nb_unreported_completions;
   while (notification_buf_pair->nb_unreported_completions ==
          nb_unreported_completions) {
-    if (park_callback_ != nullptr) {
-      std::invoke(park_callback_);
-    }
+    wait_for_tx_head(notification_buf_pair, &waiter);
     update_tx_head(notification_buf_pair);
   }
 
@@ -735,6 +1013,11 @@ int get_round_robin_status(struct NotificationBufPair* notification_buf_pair) {
   return fpga_dev->GetRrStatus();
 }
 
+void set_notif_coalescing(struct NotificationBufPair* notification_buf_pair,
+                          bool coalesce) {
+  notification_buf_pair->coalesce_notifs = coalesce;
+}
+
 uint64_t get_dev_addr_from_virt_addr(
     struct NotificationBufPair* notification_buf_pair, void* virt_addr) {
   DevBackend* fpga_dev =
@@ -743,10 +1026,24 @@ uint64_t get_dev_addr_from_virt_addr(
   return dev_addr;
 }
 
+int get_dev_addrs_from_virt_addrs(
+    struct NotificationBufPair* notification_buf_pair, void* virt_addr,
+    size_t stride, uint32_t nb_addrs, uint64_t* dev_addrs) {
+  DevBackend* fpga_dev =
+      static_cast<DevBackend*>(notification_buf_pair->fpga_dev);
+  return fpga_dev->ConvertVirtAddrsToDevAddrs(virt_addr, stride, nb_addrs,
+                                              dev_addrs);
+}
+
 void notification_buf_free(struct NotificationBufPair* notification_buf_pair) {
   DevBackend* fpga_dev =
       static_cast<DevBackend*>(notification_buf_pair->fpga_dev);
 
+  // The device could not be created, there is nothing to free.
+  if (fpga_dev == nullptr) {
+    return;
+  }
+
   fpga_dev->FreeNotifBuf(notification_buf_pair->id);
   DevBackend::mmio_write32(&notification_buf_pair->regs->rx_mem_low, 0,
                            notification_buf_pair->uio_mmap_bar2_addr);
@@ -757,7 +1054,8 @@ void notification_buf_free(struct NotificationBufPair* notification_buf_pair) {
   DevBackend::mmio_write32(&notification_buf_pair->regs->tx_mem_high, 0,
                            notification_buf_pair->uio_mmap_bar2_addr);
 
-  munmap(notification_buf_pair->rx_buf, kAlignedDscBufPairSize);
+  // `get_huge_page` maps twice the requested size.
+  munmap(notification_buf_pair->rx_buf, kBufPageSize * 2);
 
   std::string huge_page_path = notification_buf_pair->huge_page_prefix +
                                std::string(kHugePageNotifBufPathPrefix) +
@@ -765,10 +1063,13 @@ void notification_buf_free(struct NotificationBufPair* notification_buf_pair) {
 
   unlink(huge_page_path.c_str());
 
-  free(notification_buf_pair->pending_rx_pipe_tails);
+  rx_pipe_slots_free(notification_buf_pair);
   free(notification_buf_pair->wrap_tracker);
   free(notification_buf_pair->next_rx_pipe_notifs);
 
+  huge_page_arena_destroy(notification_buf_pair->pipe_buf_arena);
+  delete notification_buf_pair->pipe_buf_arena;
+
   delete fpga_dev;
 }
 
@@ -784,12 +1085,12 @@ void enso_pipe_free(struct NotificationBufPair* notification_buf_pair,
                            notification_buf_pair->uio_mmap_bar2_addr);
 
   if (enso_pipe->buf) {
-    munmap(enso_pipe->buf, kBufPageSize);
-    std::string huge_page_path = enso_pipe->huge_page_prefix +
-                                 std::string(kHugePageRxPipePathPrefix) +
-                                 std::to_string(enso_pipe_id);
-    unlink(huge_page_path.c_str());
-    enso_pipe->buf = nullptr;
+    __enso_pipe_free_buf(enso_pipe, notification_buf_pair);
+  }
+
+  if (enso_pipe->slot != kInvalidRxPipeSlot) {
+    release_rx_pipe_slot(notification_buf_pair, enso_pipe_id);
+    enso_pipe->slot = kInvalidRxPipeSlot;
   }
 
   fpga_dev->FreePipe(enso_pipe_id);
@@ -41,6 +41,7 @@
 #define ENSO_SOFTWARE_SRC_PCIE_H_
 
 #include <endian.h>
+#include <enso/fast_path.h>
 #include <enso/helpers.h>
 #include <enso/internals.h>
 #include <netinet/ether.h>
@@ -84,12 +85,36 @@ int notification_buf_init(uint32_t bdf, int32_t bar,
  * @param enso_pipe Enso Pipe to initialize.
  * @param notification_buf_pair Notification buffer pair to use.
  * @param fallback Whether the queues is a fallback queue or not.
+ * @param nb_flits Size of the pipe in flits. Must be a power of two between
+ *                 `kMinEnsoPipeSize` and `kMaxEnsoPipeSize` that is supported
+ *                 by the device.
  *
  * @return Pipe ID on success, -1 on failure.
  */
 int enso_pipe_init(struct RxEnsoPipeInternal* enso_pipe,
                    struct NotificationBufPair* notification_buf_pair,
-                   bool fallback);
+                   bool fallback, uint32_t nb_flits);
+
+/**
+ * @brief Initializes multiple Enso Pipes at once.
+ *
+ * Same as calling `enso_pipe_init` for every pipe, with the default size
+ * (`kEnsoPipeSize`), but waits for the register
+ * writes of all pipes at once and updates the fallback queues configuration
+ * only once, at the end.
+ *
+ * @param enso_pipes Array with the Enso Pipes to initialize. They must be
+ *                   zero-initialized.
+ * @param nb_pipes Number of pipes in `enso_pipes`.
+ * @param notification_buf_pair Notification buffer pair to use.
+ * @param fallback Whether the queues are fallback queues or not.
+ *
+ * @return 0 on success, -1 on failure. On failure, the pipes that had `regs`
+ *         set were allocated and must still be freed with `enso_pipe_free`.
+ */
+int enso_pipes_init(struct RxEnsoPipeInternal** enso_pipes, uint32_t nb_pipes,
+                    struct NotificationBufPair* notification_buf_pair,
+                    bool fallback);
 
 /**
  * @brief Initializes an enso pipe and the notification buffer if needed.
@@ -100,6 +125,43 @@ int dma_init(struct NotificationBufPair* notification_buf_pair,
              struct RxEnsoPipeInternal* enso_pipe, uint32_t bdf, int32_t bar,
              const std::string& huge_page_prefix, bool fallback);
 
+/**
+ * @brief Allocates the tables that hold per-pipe state for the notification
+ *        buffer. They start small and grow as pipes are enabled.
+ *
+ * @param notification_buf_pair Notification buffer pair to initialize.
+ * @return 0 on success, -1 on failure.
+ */
+int rx_pipe_slots_init(struct NotificationBufPair* notification_buf_pair);
+
+/**
+ * @brief Assigns a slot to the Enso Pipe with the given ID, reusing a freed
+ *        slot if one is available.
+ *
+ * @param notification_buf_pair Notification buffer pair to use.
+ * @param enso_pipe_id Hardware ID of the Enso Pipe.
+ * @return The slot on success, -1 on failure.
+ */
+int32_t assign_rx_pipe_slot(struct NotificationBufPair* notification_buf_pair,
+                            enso_pipe_id_t enso_pipe_id);
+
+/**
+ * @brief Releases the slot assigned to the Enso Pipe with the given ID so that
+ *        it can be reused by another pipe.
+ *
+ * @param notification_buf_pair Notification buffer pair to use.
+ * @param enso_pipe_id Hardware ID of the Enso Pipe.
+ */
+void release_rx_pipe_slot(struct NotificationBufPair* notification_buf_pair,
+                          enso_pipe_id_t enso_pipe_id);
+
+/**
+ * @brief Frees the tables allocated by `rx_pipe_slots_init`.
+ *
+ * @param notification_buf_pair Notification buffer pair to use.
+ */
+void rx_pipe_slots_free(struct NotificationBufPair* notification_buf_pair);
+
 /**
  * @brief Gets latest tails for the pipes associated with the given
  * notification buffer.
@@ -189,6 +251,30 @@ void advance_pipe(struct RxEnsoPipeInternal* enso_pipe, size_t len);
  */
 void fully_advance_pipe(struct RxEnsoPipeInternal* enso_pipe);
 
+/**
+ * @brief Reports the pipe's current head to the NIC, if any freed bytes have
+ * not been reported yet.
+ *
+ * @param enso_pipe Enso pipe to flush.
+ */
+void flush_pipe_head(struct RxEnsoPipeInternal* enso_pipe);
+
+/**
+ * @brief Sets how many freed flits `advance_pipe` and `fully_advance_pipe`
+ * may accumulate before reporting the new head to the NIC.
+ *
+ * Regardless of the threshold, the head is also reported whenever the pipe
+ * is at least half full from the NIC's perspective.
+ *
+ * @param enso_pipe Enso pipe to configure.
+ * @param nb_flits Threshold in flits (0 reports on every update). Must be at
+ *                 most half the pipe size.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int set_pipe_head_update_threshold(struct RxEnsoPipeInternal* enso_pipe,
+                                   uint32_t nb_flits);
+
 /**
  * @brief Prefetches a given Enso Pipe.
  *
@@ -208,6 +294,10 @@ void prefetch_pipe(struct RxEnsoPipeInternal* enso_pipe);
  * This function currently blocks if there is not enough space in the
  * notification buffer.
  *
+ * If a TX flush threshold is set (see `set_tx_flush_threshold`), the
+ * notifications may only be reported to the NIC by a later call or by
+ * `flush_tx`.
+ *
  * @param notification_buf_pair Notification buffer to send data through.
  * @param phys_addr Physical memory address of the data to be sent.
  * @param len Length, in bytes, of the data.
@@ -218,6 +308,46 @@ uint32_t send_to_queue(struct NotificationBufPair* notification_buf_pair,
                        uint64_t phys_addr, uint32_t len,
                        uint64_t sent_time = 0);
 
+/**
+ * @brief Sends data through a given queue, without blocking.
+ *
+ * Same as `send_to_queue`, except that it sends nothing and returns 0 if the
+ * notification buffer does not have enough space for the whole request.
+ *
+ * @param notification_buf_pair Notification buffer to send data through.
+ * @param phys_addr Physical memory address of the data to be sent.
+ * @param len Length, in bytes, of the data.
+ * @param sent_time Time to use as the packet sent time.
+ *
+ * @return number of bytes sent (either `len` or 0).
+ */
+uint32_t try_send_to_queue(struct NotificationBufPair* notification_buf_pair,
+                           uint64_t phys_addr, uint32_t len,
+                           uint64_t sent_time = 0);
+
+/**
+ * @brief Writes the TX tail to the NIC if any notifications queued by
+ * `send_to_queue` have not been reported yet.
+ *
+ * @param notification_buf_pair Notification buffer to flush.
+ */
+void flush_tx(struct NotificationBufPair* notification_buf_pair);
+
+/**
+ * @brief Sets how many notifications `send_to_queue` may queue before writing
+ * the TX tail to the NIC.
+ *
+ * Any notification that is still pending is flushed when this is called.
+ *
+ * @param notification_buf_pair Notification buffer to configure.
+ * @param nb_notifications Threshold in notifications (0 writes the tail on
+ *                         every send). Must be at most `kMaxTxFlushThreshold`.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int set_tx_flush_threshold(struct NotificationBufPair* notification_buf_pair,
+                           uint32_t nb_notifications);
+
 /**
  * @brief Returns the number of transmission requests that were completed since
  * the last call to this function.
@@ -236,13 +366,6 @@ uint32_t send_to_queue(struct NotificationBufPair* notification_buf_pair,
 uint32_t get_unreported_completions(
     struct NotificationBufPair* notification_buf_pair);
 
-/**
- * @brief Updates the tx head and the number of TX completions.
- *
- * @param notification_buf_pair Notification buffer to be updated.
- */
-void update_tx_head(struct NotificationBufPair* notification_buf_pair);
-
 /**
  * @brief Sends configuration to the NIC.
  *
@@ -287,6 +410,21 @@ int set_round_robin_status(struct NotificationBufPair* notification_buf_pair,
  */
 int get_round_robin_status(struct NotificationBufPair* notification_buf_pair);
 
+/**
+ * @brief Sets whether notifications for the same pipe should be coalesced.
+ *
+ * When enabled, a pipe that receives multiple notifications in the same call to
+ * `get_new_tails` is only returned once by `get_next_rx_notif`. The returned
+ * notification is the first one for the pipe, so callers must not rely on its
+ * `tail`. The pipe's latest tail is in `rx_pipe_slots[slot].pending_tail`,
+ * which is what the receive functions use.
+ *
+ * @param notification_buf_pair Notification buffer pair to use.
+ * @param coalesce Whether to enable or disable coalescing.
+ */
+void set_notif_coalescing(struct NotificationBufPair* notification_buf_pair,
+                          bool coalesce);
+
 /**
  * @brief Converts an address in the application's virtual address space to an
  *        address that can be used by the device (typically a physical address).
@@ -298,6 +436,21 @@ int get_round_robin_status(struct NotificationBufPair* notification_buf_pair);
 uint64_t get_dev_addr_from_virt_addr(
     struct NotificationBufPair* notification_buf_pair, void* virt_addr);
 
+/**
+ * @brief Converts multiple addresses in the application's virtual address
+ *        space to addresses that can be used by the device.
+ *
+ * @param notification_buf_pair Notification buffer pair to use.
+ * @param virt_addr First virtual address to convert.
+ * @param stride Distance in bytes between the addresses to convert.
+ * @param nb_addrs Number of addresses to convert.
+ * @param dev_addrs Array where the converted addresses will be stored.
+ * @return 0 on success, -1 if any of the addresses cannot be translated.
+ */
+int get_dev_addrs_from_virt_addrs(
+    struct NotificationBufPair* notification_buf_pair, void* virt_addr,
+    size_t stride, uint32_t nb_addrs, uint64_t* dev_addrs);
+
 /**
  * @brief Frees the notification buffer pair.
  *
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2023, Carnegie Mellon University
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *      * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <enso/ixy_helpers.h>
+#include <enso/pipe.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Needs a device, such as the one emulated by the software backend. Skipped
+// otherwise.
+static std::unique_ptr<enso::Device> create_device() {
+  // Only used by the software backend.
+  setenv("ENSO_SW_NIC_PKT_SIZE", "64", 1);
+  return enso::Device::Create();
+}
+
+// Receives at least `min_nb_bytes` on `pipe` and returns the start of the
+// received bytes, or nullptr if they do not arrive in time.
+static uint8_t* recv_at_least(enso::RxPipe* pipe, uint32_t min_nb_bytes) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (std::chrono::steady_clock::now() < deadline) {
+    uint8_t* buf;
+    uint32_t nb_bytes = pipe->Peek(&buf, ~0U);
+    if (nb_bytes >= min_nb_bytes) {
+      pipe->ConfirmBytes(nb_bytes);
+      return buf;
+    }
+    std::this_thread::yield();
+  }
+  return nullptr;
+}
+
+TEST(TestRxPipe, FreeAdvancesOverFreedRange) {
+  std::unique_ptr<enso::Device> dev = create_device();
+  if (!dev) {
+    GTEST_SKIP() << "No device available";
+  }
+
+  enso::RxPipe* pipe = dev->AllocateRxPipe(true);
+  ASSERT_NE(pipe, nullptr);
+
+  uint8_t* buf = recv_at_least(pipe, 3 * 64);
+  ASSERT_NE(buf, nullptr);
+
+  uint32_t capacity = pipe->capacity();
+
+  // Flit 1 is released out of order, so the head cannot move yet.
+  ASSERT_EQ(pipe->FreeRange(buf + 64, 64), 0);
+  EXPECT_EQ(pipe->capacity(), capacity);
+
+  // Freeing flit 0 must also free flit 1.
+  pipe->Free(64);
+  EXPECT_EQ(pipe->capacity(), capacity + 2 * 64);
+}
+
+// Waits until the bytes sent on `pipe` complete and returns its capacity.
+static uint32_t wait_for_completions(enso::TxPipe* pipe) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  uint32_t capacity = pipe->TryExtendBuf();
+  while (capacity < pipe->max_capacity() &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+    capacity = pipe->TryExtendBuf();
+  }
+  return capacity;
+}
+
+TEST(TestTxPipe, SendWrapsAroundSmallBuffer) {
+  constexpr uint32_t kBufSize = 4096;
+  constexpr uint32_t kNbBytes = 3 * 1024;
+
+  std::unique_ptr<enso::Device> dev = create_device();
+  if (!dev) {
+    GTEST_SKIP() << "No device available";
+  }
+
+  void* buf = enso::get_mirrored_buf(kBufSize);
+  ASSERT_NE(buf, nullptr);
+
+  enso::TxPipe* pipe =
+      dev->AllocateTxPipe(reinterpret_cast<uint8_t*>(buf), kBufSize);
+  ASSERT_NE(pipe, nullptr);
+  EXPECT_EQ(pipe->max_capacity(), kBufSize - enso::TxPipe::kQuantumSize);
+  uint32_t idle_capacity = pipe->capacity();
+
+  // Every other send crosses the end of the buffer and must be split.
+  for (uint32_t i = 0; i < 4; ++i) {
+    pipe->AllocateBuf(kNbBytes);
+    pipe->SendAndFree(kNbBytes);
+    EXPECT_EQ(wait_for_completions(pipe), idle_capacity);
+  }
+
+  // Same, busy waiting instead of parking if the device is full.
+  for (uint32_t i = 0; i < 4; ++i) {
+    pipe->AllocateBuf(kNbBytes);
+    pipe->SendAndFree<enso::fast_path::SpinPark>(kNbBytes);
+    EXPECT_EQ(wait_for_completions(pipe), idle_capacity);
+  }
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    pipe->AllocateBuf(kNbBytes);
+    uint32_t backlog = pipe->SendAndFreeAsync(kNbBytes);
+    while (backlog != 0) {
+      backlog = pipe->TrySendBacklog();
+    }
+    EXPECT_EQ(wait_for_completions(pipe), idle_capacity);
+  }
+
+  EXPECT_EQ(dev->AllocateTxPipe(reinterpret_cast<uint8_t*>(buf), 0), nullptr);
+
+  dev.reset();
+  enso::free_mirrored_buf(buf, kBufSize);
+}
+
+TEST(TestDevice, ForwardAndFreeRejectsLargePipes) {
+  std::unique_ptr<enso::Device> dev = create_device();
+  if (!dev) {
+    GTEST_SKIP() << "No device available";
+  }
+
+  enso::RxPipe* pipe = dev->AllocateRxPipe(true, 2 * enso::kBufPageSize);
+  ASSERT_NE(pipe, nullptr);
+
+  uint8_t* buf = recv_at_least(pipe, 64);
+  ASSERT_NE(buf, nullptr);
+  EXPECT_EQ(dev->ForwardAndFree(pipe, buf, 64), -1);
+}
@@ -30,13 +30,17 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifdef __AVX512F__
-
 #include <enso/queue.h>
 #include <gtest/gtest.h>
 
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
 TEST(TestQueue, CreateProducer) {
   auto q = enso::QueueProducer<int>::Create("CreateProducer");
@@ -199,6 +203,372 @@ TEST(TestQueue, Front) {
 //   EXPECT_EQ(q_cons->Pop().value_or(elem)[0], -1);
 // }
 
+TEST(TestQueue, PushPopBatch) {
+  auto q_prod = enso::QueueProducer<int>::Create("PushPopBatch");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_cons = enso::QueueConsumer<int>::Create("PushPopBatch");
+  EXPECT_NE(q_cons, nullptr);
+
+  std::array<int, 8> in = {0, 1, 2, 3, 4, 5, 6, 7};
+  EXPECT_EQ(q_prod->PushBatch(in.data(), in.size()), in.size());
+  EXPECT_EQ(q_prod->Push(8), 0);
+
+  std::array<int, 16> out = {};
+  EXPECT_EQ(q_cons->PopBatch(out.data(), 4), 4);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(out[i], i);
+  }
+
+  EXPECT_EQ(q_cons->Pop().value_or(-1), 4);
+
+  EXPECT_EQ(q_cons->PopBatch(out.data(), out.size()), 4);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(out[i], i + 5);
+  }
+
+  EXPECT_EQ(q_cons->PopBatch(out.data(), out.size()), 0);
+}
+
+TEST(TestQueue, PushBatchFull) {
+  auto q_prod = enso::QueueProducer<int>::Create("PushBatchFull");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_cons = enso::QueueConsumer<int>::Create("PushBatchFull");
+  EXPECT_NE(q_cons, nullptr);
+
+  uint32_t capacity = q_prod->capacity();
+  std::vector<int> in(capacity + 8);
+  for (uint32_t i = 0; i < in.size(); ++i) {
+    in[i] = i;
+  }
+
+  // Only pushes until the queue is full.
+  EXPECT_EQ(q_prod->PushBatch(in.data(), capacity - 2), capacity - 2);
+  EXPECT_EQ(q_prod->PushBatch(in.data() + capacity - 2, 8), 2);
+  EXPECT_EQ(q_prod->PushBatch(in.data(), 1), 0);
+  EXPECT_EQ(q_prod->Push(42), -1);
+
+  // Free a few elements and wrap around.
+  std::vector<int> out(in.size());
+  EXPECT_EQ(q_cons->PopBatch(out.data(), 3), 3);
+  EXPECT_EQ(q_prod->PushBatch(in.data() + capacity, 8), 3);
+
+  EXPECT_EQ(q_cons->PopBatch(out.data() + 3, out.size()), capacity);
+  for (uint32_t i = 0; i < capacity + 3; ++i) {
+    EXPECT_EQ(out[i], static_cast<int>(i));
+  }
+}
+
+TEST(TestQueue, PopBlocking) {
+  constexpr uint32_t kNbElements = 1000;
+
+  auto q_prod = enso::QueueProducer<uint32_t>::Create("PopBlocking");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_cons = enso::QueueConsumer<uint32_t>::Create("PopBlocking");
+  EXPECT_NE(q_cons, nullptr);
+
+  std::thread producer([&q_prod] {
+    for (uint32_t i = 0; i < kNbElements; ++i) {
+      while (q_prod->Push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // Park quickly so that the slow stages are also exercised.
+  enso::WaitStrategy strategy;
+  strategy.nb_spins = 1;
+  strategy.nb_monitor_waits = 1;
+  strategy.park = true;
+  strategy.park_timeout_us = 10;
+
+  for (uint32_t i = 0; i < kNbElements; ++i) {
+    uint32_t data =
+        (i % 2 == 0) ? q_cons->PopBlocking() : q_cons->PopBlocking(strategy);
+    EXPECT_EQ(data, i);
+  }
+
+  producer.join();
+  EXPECT_TRUE(q_cons->IsEmpty());
+}
+
+TEST(TestQueue, MpmcPushPop) {
+  auto q_cons = enso::MpmcQueueConsumer<int>::Create("MpmcPushPop");
+  EXPECT_NE(q_cons, nullptr);
+
+  auto q_prod = enso::MpmcQueueProducer<int>::Create("MpmcPushPop");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_prod2 = enso::MpmcQueueProducer<int>::Create("MpmcPushPop");
+  EXPECT_NE(q_prod2, nullptr);
+
+  EXPECT_TRUE(q_cons->IsEmpty());
+  EXPECT_EQ(q_prod->Push(42), 0);
+  EXPECT_EQ(q_prod2->Push(43), 0);
+  EXPECT_FALSE(q_cons->IsEmpty());
+
+  EXPECT_EQ(q_cons->Pop().value_or(-1), 42);
+  EXPECT_EQ(q_cons->Pop().value_or(-1), 43);
+  EXPECT_EQ(q_cons->Pop().value_or(-1), -1);
+  EXPECT_TRUE(q_cons->IsEmpty());
+}
+
+TEST(TestQueue, MpmcQueueFull) {
+  auto q_prod = enso::MpmcQueueProducer<int>::Create("MpmcQueueFull");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_cons = enso::MpmcQueueConsumer<int>::Create("MpmcQueueFull");
+  EXPECT_NE(q_cons, nullptr);
+
+  // The header takes part of the buffer.
+  uint32_t capacity = enso::kBufPageSize / enso::kCacheLineSize / 2;
+  EXPECT_EQ(q_prod->capacity(), capacity);
+
+  // Fill the queue twice to make sure it wraps around.
+  for (int round = 0; round < 2; ++round) {
+    for (uint32_t i = 0; i < capacity; ++i) {
+      EXPECT_EQ(q_prod->Push(i), 0);
+    }
+    EXPECT_EQ(q_prod->Push(42), -1);
+
+    for (uint32_t i = 0; i < capacity; ++i) {
+      EXPECT_EQ(q_cons->Pop().value_or(-1), static_cast<int>(i));
+    }
+    EXPECT_EQ(q_cons->Pop().value_or(-1), -1);
+  }
+}
+
+TEST(TestQueue, MpmcConcurrentProducers) {
+  constexpr uint32_t kNbProducers = 4;
+  constexpr uint32_t kNbElementsPerProducer = 100000;
+
+  auto q_cons = enso::MpmcQueueConsumer<uint32_t>::Create(
+      "MpmcConcurrentProducers", -1, 0, enso::kBufPageSize);
+  ASSERT_NE(q_cons, nullptr);
+
+  // Producers are created before starting any thread, as a failed assertion
+  // in a producer thread would leave the consumer waiting forever.
+  std::vector<std::unique_ptr<enso::MpmcQueueProducer<uint32_t>>> q_prods;
+  for (uint32_t p = 0; p < kNbProducers; ++p) {
+    q_prods.push_back(enso::MpmcQueueProducer<uint32_t>::Create(
+        "MpmcConcurrentProducers", -1, 0, enso::kBufPageSize));
+    ASSERT_NE(q_prods.back(), nullptr);
+  }
+
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < kNbProducers; ++p) {
+    producers.emplace_back([p, q_prod = q_prods[p].get()] {
+      for (uint32_t i = 0; i < kNbElementsPerProducer; ++i) {
+        while (q_prod->Push(p * kNbElementsPerProducer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Every element must be received exactly once and, for each producer, in
+  // the order it was pushed.
+  std::array<uint32_t, kNbProducers> next = {};
+  uint32_t nb_received = 0;
+  while (nb_received < kNbProducers * kNbElementsPerProducer) {
+    std::optional<uint32_t> data = q_cons->Pop();
+    if (!data) {
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t p = *data / kNbElementsPerProducer;
+    ASSERT_LT(p, kNbProducers);
+    EXPECT_EQ(*data % kNbElementsPerProducer, next[p]);
+    ++next[p];
+    ++nb_received;
+  }
+
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(q_cons->IsEmpty());
+}
+
+TEST(TestByteQueue, PushPeekRelease) {
+  auto q_prod = enso::ByteQueueProducer::Create("PushPeekRelease");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_cons = enso::ByteQueueConsumer::Create("PushPeekRelease");
+  EXPECT_NE(q_cons, nullptr);
+
+  uint32_t nb_bytes = 0;
+  EXPECT_EQ(q_cons->Peek(&nb_bytes), nullptr);
+
+  std::string first = "first message";
+  std::string second(200, 'x');
+  EXPECT_EQ(q_prod->Push(first.data(), first.size()), 0);
+  EXPECT_EQ(q_prod->Push(second.data(), second.size()), 0);
+
+  uint8_t* data = q_cons->Peek(&nb_bytes);
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(std::string(reinterpret_cast<char*>(data), nb_bytes), first);
+
+  // Peeking again returns the same record.
+  EXPECT_EQ(q_cons->Peek(&nb_bytes), data);
+  q_cons->Release();
+
+  data = q_cons->Peek(&nb_bytes);
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(std::string(reinterpret_cast<char*>(data), nb_bytes), second);
+  q_cons->Release();
+
+  EXPECT_EQ(q_cons->Peek(&nb_bytes), nullptr);
+  EXPECT_TRUE(q_cons->IsEmpty());
+}
+
+TEST(TestByteQueue, ReserveCommit) {
+  auto q_prod = enso::ByteQueueProducer::Create("ReserveCommit");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_cons = enso::ByteQueueConsumer::Create("ReserveCommit");
+  EXPECT_NE(q_cons, nullptr);
+
+  // Reserve more than needed and commit only what was written.
+  uint8_t* record = q_prod->Reserve(1500);
+  ASSERT_NE(record, nullptr);
+  memset(record, 7, 100);
+  q_prod->Commit(100);
+
+  // Empty records are allowed.
+  ASSERT_NE(q_prod->Reserve(0), nullptr);
+  q_prod->Commit(0);
+
+  uint32_t nb_bytes = 0;
+  uint8_t* data = q_cons->Peek(&nb_bytes);
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(nb_bytes, 100);
+  EXPECT_EQ(data[99], 7);
+  q_cons->Release();
+
+  ASSERT_NE(q_cons->Peek(&nb_bytes), nullptr);
+  EXPECT_EQ(nb_bytes, 0);
+  q_cons->Release();
+
+  EXPECT_TRUE(q_cons->IsEmpty());
+}
+
+TEST(TestByteQueue, FullAndWrapAround) {
+  auto q_prod = enso::ByteQueueProducer::Create("FullAndWrapAround");
+  EXPECT_NE(q_prod, nullptr);
+
+  auto q_cons = enso::ByteQueueConsumer::Create("FullAndWrapAround");
+  EXPECT_NE(q_cons, nullptr);
+
+  EXPECT_EQ(q_prod->Reserve(q_prod->max_record_size() + 1), nullptr);
+
+  // A leading 64-byte record offsets the following ones, so that the records
+  // no longer divide the buffer evenly.
+  std::vector<uint8_t> small(64 - 8, 0xff);
+  EXPECT_EQ(q_prod->Push(small.data(), small.size()), 0);
+
+  // Records take 1KB each, including the header.
+  std::vector<uint8_t> in(1024 - 8);
+  uint32_t nb_records = (q_prod->size() - 64) / 1024;
+  for (uint32_t i = 0; i < nb_records; ++i) {
+    in[0] = i;
+    EXPECT_EQ(q_prod->Push(in.data(), in.size()), 0);
+  }
+  EXPECT_EQ(q_prod->Push(in.data(), in.size()), -1);
+
+  uint32_t nb_bytes = 0;
+  uint8_t* buf_start = q_cons->Peek(&nb_bytes);
+  ASSERT_NE(buf_start, nullptr);
+  ASSERT_EQ(nb_bytes, small.size());
+  q_cons->Release();
+
+  // Releasing the first two 1KB records leaves space for a record that starts
+  // before the end of the buffer and finishes after it.
+  for (uint32_t i = 0; i < 2; ++i) {
+    uint8_t* data = q_cons->Peek(&nb_bytes);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(data[0], static_cast<uint8_t>(i));
+    q_cons->Release();
+  }
+
+  uint64_t big_pos = 64 + nb_records * 1024;
+  uint64_t free_bytes = q_prod->size() - big_pos + 64 + 2 * 1024;
+  ASSERT_LT(big_pos, q_prod->size());
+  ASSERT_GT(big_pos + free_bytes, q_prod->size());
+
+  std::vector<uint8_t> big(free_bytes - 8);
+  for (uint32_t i = 0; i < big.size(); ++i) {
+    big[i] = i;
+  }
+  EXPECT_EQ(q_prod->Push(big.data(), big.size()), 0);
+  EXPECT_EQ(q_prod->Push(in.data(), 1), -1);
+
+  for (uint32_t i = 2; i < nb_records; ++i) {
+    uint8_t* data = q_cons->Peek(&nb_bytes);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(data[0], static_cast<uint8_t>(i));
+    q_cons->Release();
+  }
+
+  // Record that wraps around is contiguous.
+  uint8_t* data = q_cons->Peek(&nb_bytes);
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(data, buf_start + big_pos);
+  ASSERT_EQ(nb_bytes, big.size());
+  EXPECT_EQ(memcmp(data, big.data(), big.size()), 0);
+  q_cons->Release();
+
+  EXPECT_TRUE(q_cons->IsEmpty());
+}
+
+TEST(TestByteQueue, ConcurrentProducerConsumer) {
+  constexpr uint32_t kNbRecords = 100000;
+  constexpr uint32_t kMaxRecordSize = 3000;
+
+  auto q_cons = enso::ByteQueueConsumer::Create("ConcurrentProducerConsumer");
+  EXPECT_NE(q_cons, nullptr);
+
+  // Every record carries its index followed by bytes derived from it, with a
+  // size that varies between records.
+  auto record_size = [](uint32_t i) {
+    return sizeof(uint32_t) + 1 + (i * 7919) % kMaxRecordSize;
+  };
+
+  std::thread producer([&record_size] {
+    auto q_prod =
+        enso::ByteQueueProducer::Create("ConcurrentProducerConsumer");
+    ASSERT_NE(q_prod, nullptr);
+    for (uint32_t i = 0; i < kNbRecords; ++i) {
+      uint32_t nb_bytes = record_size(i);
+      uint8_t* record;
+      while ((record = q_prod->Reserve(nb_bytes)) == nullptr) {
+        std::this_thread::yield();
+      }
+      memcpy(record, &i, sizeof(i));
+      memset(record + sizeof(i), i, nb_bytes - sizeof(i));
+      q_prod->Commit(nb_bytes);
+    }
+  });
+
+  for (uint32_t i = 0; i < kNbRecords; ++i) {
+    uint32_t nb_bytes = 0;
+    uint8_t* data;
+    while ((data = q_cons->Peek(&nb_bytes)) == nullptr) {
+      std::this_thread::yield();
+    }
+    uint32_t index;
+    memcpy(&index, data, sizeof(index));
+    ASSERT_EQ(index, i);
+    ASSERT_EQ(nb_bytes, record_size(i));
+    ASSERT_EQ(data[nb_bytes - 1], static_cast<uint8_t>(i));
+    q_cons->Release();
+  }
+
+  producer.join();
+  EXPECT_TRUE(q_cons->IsEmpty());
+}
+
 TEST(TestQueue, JoinExisting) {
   auto q_prod = enso::QueueProducer<int>::Create("JoinExisting", 0, false);
   EXPECT_NE(q_prod, nullptr);
@@ -212,5 +582,3 @@ TEST(TestQueue, JoinExisting) {
   auto q_cons2 = enso::QueueConsumer<int>::Create("JoinExisting", 0, false);
   EXPECT_EQ(q_cons2, nullptr);
 }
-
-#endif  // __AVX512F__